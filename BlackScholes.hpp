@@ -1,7 +1,10 @@
 #pragma once
 
 #include <cmath>
+#include <stdexcept>
+#include <string>
 #include "NormalDistribution.hpp"
+#include "Instrumentation.hpp"
 
 
 double BSCall(double spot, double time, double strike, double expiry, double vol, double rate) {
@@ -27,6 +30,8 @@ double BSCall(double spot, double time, double strike, double expiry, double vol
   float
       The Black-Scholes call price.*/
 
+    BS_PROBE(BSCall);
+
     vol /= 100;
     rate /= 100;
     double d1 = (log(spot / strike) + (rate + pow(vol, 2) / 2) * (expiry - time)) / vol / sqrt(expiry - time);
@@ -63,6 +68,8 @@ double BSPut(double spot, double time, double strike, double expiry, double vol,
             The Black-Scholes put price.
     */
 
+    BS_PROBE(BSPut);
+
     vol /= 100;
 
     rate /= 100;
@@ -102,6 +109,8 @@ double BSCall_Delta(double spot, double time, double strike, double expiry, doub
             The Black-Scholes call delta.
     */
 
+    BS_PROBE(BSCall_Delta);
+
     vol /= 100;
     rate /= 100;
 
@@ -137,6 +146,8 @@ double BSPut_Delta(double spot, double time, double strike, double expiry, doubl
             The Black-Scholes put delta.
     */
 
+    BS_PROBE(BSPut_Delta);
+
     vol /= 100;
 
     rate /= 100;
@@ -174,6 +185,8 @@ double BSCall_Gamma(double spot, double time, double strike, double expiry, doub
             The Black-Scholes call gamma.
     */
 
+    BS_PROBE(BSCall_Gamma);
+
     vol /= 100;
 
     rate /= 100;
@@ -211,6 +224,8 @@ double BSPut_Gamma(double spot, double time, double strike, double expiry, doubl
             The Black-Scholes put gamma.
     */
 
+    BS_PROBE(BSPut_Gamma);
+
     vol /= 100;
 
     rate /= 100;
@@ -249,6 +264,8 @@ double BSCall_Theta(double spot, double time, double strike, double expiry, doub
             The 1 day Black-Scholes call theta.
     */
 
+    BS_PROBE(BSCall_Theta);
+
     vol /= 100;
 
     rate /= 100;
@@ -290,6 +307,8 @@ double BSPut_Theta(double spot, double time, double strike, double expiry, doubl
             The 1 day Black-Scholes put theta.
     */
 
+    BS_PROBE(BSPut_Theta);
+
     vol /= 100;
 
     rate /= 100;
@@ -330,6 +349,8 @@ double BSCall_Vega(double spot, double time, double strike, double expiry, doubl
             The Black-Scholes call vega.
     */
 
+    BS_PROBE(BSCall_Vega);
+
     vol /= 100;
 
     rate /= 100;
@@ -365,6 +386,8 @@ double BSPut_Vega(double spot, double time, double strike, double expiry, double
         The Black-Scholes call vega.
 */
 
+    BS_PROBE(BSPut_Vega);
+
     vol /= 100;
 
     rate /= 100;
@@ -376,3 +399,209 @@ double BSPut_Vega(double spot, double time, double strike, double expiry, double
     return spot * sqrt(expiry - time) * norm.pdf(d1) / 100;
 }
 
+
+double BSGeometricAsianCall(double spot, double time, double strike, double expiry, double vol, double rate, int fixings) {
+    /*
+        Calculates the price of a call on the discretely sampled geometric average
+        of the underlying.
+
+        Parameters
+        ----------
+        spot: float
+            The spot price of the underlying.
+        time: float
+            The time when the call price is to be evaluated.
+        strike: float
+            The strike price of the call.
+        expiry: float
+            The expiration date of the call.
+        vol: float
+            The implied volatility to use to price the call (as a percentage).
+        rate: float
+            The risk free interest rate to use in the model (as a percentage).
+        fixings: int
+            The number of equally spaced averaging dates; the last one is expiry
+            and the first is one spacing after time.
+
+        Returns
+        -------
+        float
+            The geometric Asian call price.
+    */
+
+    BS_PROBE(BSGeometricAsianCall);
+
+    vol /= 100;
+
+    rate /= 100;
+
+    double dt = (expiry - time) / fixings;
+
+    double mean = log(spot) + (rate - pow(vol, 2) / 2) * dt * (fixings + 1) / 2;
+
+    double variance = pow(vol, 2) * dt * (fixings + 1) * (2 * fixings + 1) / (6 * fixings);
+
+    double d2 = (mean - log(strike)) / sqrt(variance);
+
+    double d1 = d2 + sqrt(variance);
+
+    NormalDistribution norm(0, 1);
+
+    return exp(-rate * (expiry - time)) * (exp(mean + variance / 2) * norm.cdf(d1) - strike * norm.cdf(d2));
+}
+
+double BSGeometricAsianPut(double spot, double time, double strike, double expiry, double vol, double rate, int fixings) {
+    /*
+        Calculates the price of a put on the discretely sampled geometric average
+        of the underlying.
+
+        Parameters
+        ----------
+        As BSGeometricAsianCall.
+
+        Returns
+        -------
+        float
+            The geometric Asian put price.
+    */
+
+    BS_PROBE(BSGeometricAsianPut);
+
+    vol /= 100;
+
+    rate /= 100;
+
+    double dt = (expiry - time) / fixings;
+
+    double mean = log(spot) + (rate - pow(vol, 2) / 2) * dt * (fixings + 1) / 2;
+
+    double variance = pow(vol, 2) * dt * (fixings + 1) * (2 * fixings + 1) / (6 * fixings);
+
+    double d2 = (mean - log(strike)) / sqrt(variance);
+
+    double d1 = d2 + sqrt(variance);
+
+    NormalDistribution norm(0, 1);
+
+    return exp(-rate * (expiry - time)) * (strike * norm.cdf(-d2) - exp(mean + variance / 2) * norm.cdf(-d1));
+}
+
+
+double BSBarrier(double spot, double time, double strike, double expiry, double vol, double rate,
+                 double barrier, std::string barrier_type, double phi) {
+    /*
+        Reiner-Rubinstein price of a continuously monitored single barrier option
+        without rebate. phi is 1 for a call and -1 for a put; use BSBarrierCall and
+        BSBarrierPut rather than calling this directly.
+    */
+
+    bool is_down = barrier_type == "down-and-out" || barrier_type == "down-and-in";
+    bool is_in = barrier_type == "down-and-in" || barrier_type == "up-and-in";
+
+    if (!is_down && barrier_type != "up-and-out" && barrier_type != "up-and-in") {
+        throw std::invalid_argument("Invalid barrier type");
+    }
+
+    // Already knocked: the out option is worthless and the in option is vanilla.
+    if (is_down ? spot <= barrier : spot >= barrier) {
+        if (!is_in) return 0;
+        return phi > 0 ? BSCall(spot, time, strike, expiry, vol, rate) : BSPut(spot, time, strike, expiry, vol, rate);
+    }
+
+    double eta = is_down ? 1 : -1;
+
+    vol /= 100;
+
+    rate /= 100;
+
+    double tau = expiry - time;
+
+    double vol_sqrt_tau = vol * sqrt(tau);
+
+    double mu = (rate - pow(vol, 2) / 2) / pow(vol, 2);
+
+    double discount = exp(-rate * tau);
+
+    NormalDistribution norm(0, 1);
+
+    double x1 = log(spot / strike) / vol_sqrt_tau + (1 + mu) * vol_sqrt_tau;
+    double x2 = log(spot / barrier) / vol_sqrt_tau + (1 + mu) * vol_sqrt_tau;
+    double y1 = log(barrier * barrier / (spot * strike)) / vol_sqrt_tau + (1 + mu) * vol_sqrt_tau;
+    double y2 = log(barrier / spot) / vol_sqrt_tau + (1 + mu) * vol_sqrt_tau;
+
+    double A = phi * spot * norm.cdf(phi * x1) - phi * strike * discount * norm.cdf(phi * x1 - phi * vol_sqrt_tau);
+    double B = phi * spot * norm.cdf(phi * x2) - phi * strike * discount * norm.cdf(phi * x2 - phi * vol_sqrt_tau);
+    double C = phi * spot * pow(barrier / spot, 2 * (mu + 1)) * norm.cdf(eta * y1)
+        - phi * strike * discount * pow(barrier / spot, 2 * mu) * norm.cdf(eta * y1 - eta * vol_sqrt_tau);
+    double D = phi * spot * pow(barrier / spot, 2 * (mu + 1)) * norm.cdf(eta * y2)
+        - phi * strike * discount * pow(barrier / spot, 2 * mu) * norm.cdf(eta * y2 - eta * vol_sqrt_tau);
+
+    bool strike_above = strike > barrier;
+
+    if (phi > 0) {
+        if (is_down && is_in) return strike_above ? C : A - B + D;
+        if (is_down) return strike_above ? A - C : B - D;
+        if (is_in) return strike_above ? A : B - C + D;
+        return strike_above ? 0 : A - B + C - D;
+    }
+
+    if (is_down && is_in) return strike_above ? B - C + D : A;
+    if (is_down) return strike_above ? A - B + C - D : 0;
+    if (is_in) return strike_above ? A - B + D : C;
+    return strike_above ? B - D : A - C;
+}
+
+double BSBarrierCall(double spot, double time, double strike, double expiry, double vol, double rate,
+                     double barrier, std::string barrier_type) {
+    /*
+        Calculates the price of a continuously monitored barrier call without rebate.
+
+        Parameters
+        ----------
+        spot: float
+            The spot price of the underlying.
+        time: float
+            The time when the call price is to be evaluated.
+        strike: float
+            The strike price of the call.
+        expiry: float
+            The expiration date of the call.
+        vol: float
+            The implied volatility to use to price the call (as a percentage).
+        rate: float
+            The risk free interest rate to use in the model (as a percentage).
+        barrier: float
+            The barrier level.
+        barrier_type: string
+            One of "down-and-out", "down-and-in", "up-and-out" or "up-and-in".
+
+        Returns
+        -------
+        float
+            The barrier call price.
+    */
+
+    BS_PROBE(BSBarrierCall);
+
+    return BSBarrier(spot, time, strike, expiry, vol, rate, barrier, barrier_type, 1);
+}
+
+double BSBarrierPut(double spot, double time, double strike, double expiry, double vol, double rate,
+                    double barrier, std::string barrier_type) {
+    /*
+        Calculates the price of a continuously monitored barrier put without rebate.
+
+        Parameters
+        ----------
+        As BSBarrierCall.
+
+        Returns
+        -------
+        float
+            The barrier put price.
+    */
+
+    BS_PROBE(BSBarrierPut);
+
+    return BSBarrier(spot, time, strike, expiry, vol, rate, barrier, barrier_type, -1);
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include "BlackScholes.hpp"
+#include "MonteCarloSimulator.hpp"
+
+/*
+    Path-dependent payoffs for monte_carlo_price() in MonteCarloSimulator.hpp.
+
+    Every payoff keeps a few doubles of running state per path and updates them with
+    one loop per time step, so memory does not grow with the number of steps.
+    Asian fixings are the simulation time steps: settings.steps equally spaced dates
+    ending at expiry.
+
+        ArithmeticAsianPayoff asian(100, "call");
+        MonteCarloSettings settings;
+        settings.steps = 12;
+        MonteCarloResult r = monte_carlo_price(spot, 0, 1, 20, 5, asian, settings);
+*/
+
+
+inline double option_sign(const std::string& type) {
+    if (type == "call") return 1;
+    if (type == "put") return -1;
+    throw std::invalid_argument("Invalid type");
+}
+
+
+class ArithmeticAsianPayoff {
+    /*
+    Fixed strike option on the arithmetic average of the fixings. The geometric
+    average option on the same path is the control variate, priced exactly by
+    BSGeometricAsianCall / BSGeometricAsianPut.
+    */
+public:
+    ArithmeticAsianPayoff(double strike, std::string type = "call") : strike(strike), phi(option_sign(type)) {}
+
+    void begin(const PathGrid& grid, std::size_t n) {
+        fixings = double(grid.steps);
+        for (std::size_t p = 0; p < n; p++) {
+            sum[p] = 0;
+            log_sum[p] = 0;
+        }
+    }
+
+    void observe(std::size_t, const double*, const double* log_spot, const double* spot, const double*, std::size_t n) {
+        for (std::size_t p = 0; p < n; p++) {
+            sum[p] += spot[p];
+            log_sum[p] += log_spot[p];
+        }
+    }
+
+    void finish(std::size_t n, double* payoff, double* control) const {
+        for (std::size_t p = 0; p < n; p++) {
+            payoff[p] = std::max(phi * (sum[p] / fixings - strike), 0.0);
+            control[p] = std::max(phi * (std::exp(log_sum[p] / fixings) - strike), 0.0);
+        }
+    }
+
+    double control_value(const PathGrid& g) const {
+        int n = static_cast<int>(g.steps);
+        if (phi > 0) return BSGeometricAsianCall(g.spot, g.time, strike, g.expiry, g.vol, g.rate, n);
+        return BSGeometricAsianPut(g.spot, g.time, strike, g.expiry, g.vol, g.rate, n);
+    }
+
+    bool needs_uniforms() const { return false; }
+
+private:
+    double strike;
+    double phi;
+    double fixings = 1;
+    double sum[mc_block_paths];
+    double log_sum[mc_block_paths];
+};
+
+
+class GeometricAsianPayoff {
+    /*
+    Fixed strike option on the geometric average of the fixings. It has a closed
+    form, so this is mainly useful for checking the engine; the vanilla European on
+    the terminal spot is the control variate.
+    */
+public:
+    GeometricAsianPayoff(double strike, std::string type = "call") : strike(strike), phi(option_sign(type)) {}
+
+    void begin(const PathGrid& grid, std::size_t n) {
+        fixings = double(grid.steps);
+        for (std::size_t p = 0; p < n; p++) log_sum[p] = 0;
+    }
+
+    void observe(std::size_t, const double*, const double* log_spot, const double* spot, const double*, std::size_t n) {
+        for (std::size_t p = 0; p < n; p++) {
+            log_sum[p] += log_spot[p];
+            terminal[p] = spot[p];
+        }
+    }
+
+    void finish(std::size_t n, double* payoff, double* control) const {
+        for (std::size_t p = 0; p < n; p++) {
+            payoff[p] = std::max(phi * (std::exp(log_sum[p] / fixings) - strike), 0.0);
+            control[p] = std::max(phi * (terminal[p] - strike), 0.0);
+        }
+    }
+
+    double control_value(const PathGrid& g) const {
+        if (phi > 0) return BSCall(g.spot, g.time, strike, g.expiry, g.vol, g.rate);
+        return BSPut(g.spot, g.time, strike, g.expiry, g.vol, g.rate);
+    }
+
+    bool needs_uniforms() const { return false; }
+
+private:
+    double strike;
+    double phi;
+    double fixings = 1;
+    double log_sum[mc_block_paths];
+    double terminal[mc_block_paths];
+};
+
+
+class BarrierPayoff {
+    /*
+    Single barrier knock-in or knock-out option without rebate.
+
+    With continuous monitoring the probability that the Brownian bridge between two
+    time steps touched the barrier, exp(-2 a b / (sigma^2 dt)) for log distances a
+    and b from the barrier, is folded into a survival probability instead of
+    checking only the simulated points. This removes the discretisation bias, so a
+    single time step prices the continuously monitored barrier exactly; the vanilla
+    option is the control variate.
+
+    With discrete monitoring the barrier is checked at each time step only and the
+    bridge-corrected continuous payoff on the same path is the control variate,
+    priced exactly by BSBarrierCall / BSBarrierPut.
+    */
+public:
+    BarrierPayoff(double strike, std::string type, double barrier, std::string barrier_type, bool continuous = true)
+        : strike(strike), phi(option_sign(type)), barrier(barrier), barrier_type(barrier_type), continuous(continuous) {
+        if (barrier_type == "down-and-out" || barrier_type == "down-and-in") is_down = true;
+        else if (barrier_type == "up-and-out" || barrier_type == "up-and-in") is_down = false;
+        else throw std::invalid_argument("Invalid barrier type");
+
+        is_in = barrier_type == "down-and-in" || barrier_type == "up-and-in";
+        if (barrier <= 0) throw std::invalid_argument("Barrier must be positive");
+    }
+
+    void begin(const PathGrid& grid, std::size_t n) {
+        log_barrier = std::log(barrier);
+        inv_bridge_variance = 1 / (grid.sigma * grid.sigma * grid.dt);
+
+        bool alive = is_down ? grid.spot > barrier : grid.spot < barrier;
+        for (std::size_t p = 0; p < n; p++) {
+            survival[p] = alive ? 1 : 0;
+            discrete_alive[p] = alive ? 1 : 0;
+        }
+    }
+
+    void observe(std::size_t, const double* log_prev, const double* log_spot, const double* spot, const double*,
+                 std::size_t n) {
+        double side = is_down ? 1 : -1;
+        for (std::size_t p = 0; p < n; p++) {
+            double a = side * (log_prev[p] - log_barrier);
+            double b = side * (log_spot[p] - log_barrier);
+            double safe = (a > 0 && b > 0) ? 1 : 0;
+            survival[p] *= safe * (1 - std::exp(-2 * a * b * inv_bridge_variance));
+            discrete_alive[p] *= b > 0 ? 1 : 0;
+            terminal[p] = spot[p];
+        }
+    }
+
+    void finish(std::size_t n, double* payoff, double* control) const {
+        for (std::size_t p = 0; p < n; p++) {
+            double vanilla = std::max(phi * (terminal[p] - strike), 0.0);
+            double bridge = vanilla * (is_in ? 1 - survival[p] : survival[p]);
+            double discrete = vanilla * (is_in ? 1 - discrete_alive[p] : discrete_alive[p]);
+
+            payoff[p] = continuous ? bridge : discrete;
+            control[p] = continuous ? vanilla : bridge;
+        }
+    }
+
+    double control_value(const PathGrid& g) const {
+        if (continuous) {
+            if (phi > 0) return BSCall(g.spot, g.time, strike, g.expiry, g.vol, g.rate);
+            return BSPut(g.spot, g.time, strike, g.expiry, g.vol, g.rate);
+        }
+        if (phi > 0) return BSBarrierCall(g.spot, g.time, strike, g.expiry, g.vol, g.rate, barrier, barrier_type);
+        return BSBarrierPut(g.spot, g.time, strike, g.expiry, g.vol, g.rate, barrier, barrier_type);
+    }
+
+    bool needs_uniforms() const { return false; }
+
+private:
+    double strike;
+    double phi;
+    double barrier;
+    std::string barrier_type;
+    bool continuous;
+    bool is_down = true;
+    bool is_in = false;
+    double log_barrier = 0;
+    double inv_bridge_variance = 0;
+    double survival[mc_block_paths];
+    double discrete_alive[mc_block_paths];
+    double terminal[mc_block_paths];
+};
+
+
+class LookbackPayoff {
+    /*
+    Lookback option on the maximum or minimum of the underlying.
+
+    strike_type "floating" pays S_T - min (call) or max - S_T (put); "fixed" pays
+    max - K (call) or K - min (put), floored at zero. With continuous monitoring the
+    extreme of the Brownian bridge between two time steps is sampled exactly from
+    one uniform per step, so the continuously monitored lookback is priced without
+    discretisation bias. The control variate is the terminal spot (floating) or the
+    vanilla option with the same strike (fixed).
+    */
+public:
+    LookbackPayoff(std::string type, std::string strike_type = "floating", double strike = 0, bool continuous = true)
+        : phi(option_sign(type)), strike(strike), continuous(continuous) {
+        if (strike_type == "floating") floating = true;
+        else if (strike_type == "fixed") floating = false;
+        else throw std::invalid_argument("Invalid strike type");
+    }
+
+    void begin(const PathGrid& grid, std::size_t n) {
+        bridge_variance = grid.sigma * grid.sigma * grid.dt;
+        // Calls on the maximum and puts on the minimum (fixed); the reverse for floating.
+        track_max = floating ? phi < 0 : phi > 0;
+        for (std::size_t p = 0; p < n; p++) extreme[p] = grid.log_spot;
+    }
+
+    void observe(std::size_t, const double* log_prev, const double* log_spot, const double* spot, const double* uniform,
+                 std::size_t n) {
+        double side = track_max ? 1 : -1;
+        for (std::size_t p = 0; p < n; p++) {
+            double candidate = log_spot[p];
+            if (continuous) {
+                double jump = log_spot[p] - log_prev[p];
+                double spread = std::sqrt(jump * jump - 2 * bridge_variance * std::log(uniform[p]));
+                candidate = (log_prev[p] + log_spot[p] + side * spread) / 2;
+            }
+            extreme[p] = track_max ? std::max(extreme[p], candidate) : std::min(extreme[p], candidate);
+            terminal[p] = spot[p];
+        }
+    }
+
+    void finish(std::size_t n, double* payoff, double* control) const {
+        for (std::size_t p = 0; p < n; p++) {
+            double e = std::exp(extreme[p]);
+            if (floating) {
+                payoff[p] = phi * (terminal[p] - e);
+                control[p] = terminal[p];
+            } else {
+                payoff[p] = std::max(phi * (e - strike), 0.0);
+                control[p] = std::max(phi * (terminal[p] - strike), 0.0);
+            }
+        }
+    }
+
+    double control_value(const PathGrid& g) const {
+        if (floating) return g.spot;
+        if (phi > 0) return BSCall(g.spot, g.time, strike, g.expiry, g.vol, g.rate);
+        return BSPut(g.spot, g.time, strike, g.expiry, g.vol, g.rate);
+    }
+
+    bool needs_uniforms() const { return continuous; }
+
+private:
+    double phi;
+    double strike;
+    bool continuous;
+    bool floating = true;
+    bool track_max = false;
+    double bridge_variance = 0;
+    double extreme[mc_block_paths];
+    double terminal[mc_block_paths];
+};
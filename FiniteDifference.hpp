@@ -0,0 +1,550 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    Crank-Nicolson finite-difference solver for the Black-Scholes PDE
+
+        dV/dtau = 1/2 sigma^2 S^2 V_SS + r S V_S - r V
+
+    on a non-uniform spot grid, for European and American calls and puts with
+    optional knock-out barriers. One solve gives the whole price curve against spot,
+    and delta and gamma at every node, so a spot ladder costs a single solve instead
+    of one pricing call per spot.
+
+    Contracts are solved in batches. Every contract in a batch has the same number of
+    nodes and time steps but its own grid and time step, and all per-node arrays are
+    stored structure-of-arrays as a[node * batch + contract]. Each tridiagonal solve
+    then runs its sequential sweep over nodes with an inner loop over contracts that
+    the compiler can vectorize.
+
+    Details:
+    - The spot grid is a sinh map concentrating nodes around the strike
+      (Tavella-Randall) with the strike on a node, bounded by the barriers when
+      there are any. Prices converge at second order in the grid spacing
+      (pde_convergence_test.cpp).
+    - The first rannacher_steps time steps are each replaced by two fully implicit
+      half steps, which damps the oscillations Crank-Nicolson otherwise produces
+      from the kink in the payoff and the jump at a barrier.
+    - American exercise is handled either by the Brennan-Schwartz algorithm (a
+      direct solve with the exercise constraint applied during back substitution)
+      or by projected SOR. Brennan-Schwartz is exact when the exercise region is a
+      single interval at one end of the grid. It lies below the continuation region
+      for a put, or for a call knocked out below its strike, and above it for a call
+      knocked out above its strike, so the elimination runs in the matching
+      direction for each contract. A contract that can be exercised at both ends (a
+      put knocked out above its strike, or a call with a lower barrier above its
+      strike and an upper barrier) is rejected and needs projected SOR.
+    - Barriers are knock-out without rebate; a knock-in price is the vanilla price
+      less the knock-out price.
+*/
+
+
+struct PdeContract {
+    // vol and rate are percentages, as in BlackScholes.hpp. A barrier of zero means
+    // no barrier on that side.
+    double strike;
+    double time;
+    double expiry;
+    double vol;
+    double rate;
+    std::string type = "call";
+    bool american = false;
+    double lower_barrier = 0;
+    double upper_barrier = 0;
+};
+
+
+struct PdeSettings {
+    std::size_t space_steps = 200;       // Grid intervals; the grid has space_steps + 1 nodes.
+    std::size_t time_steps = 100;
+    std::size_t rannacher_steps = 2;
+    double concentration = 0.1;          // Width of the fine region around the strike, as a fraction of strike.
+    double std_devs = 5;                 // Upper grid bound is strike * exp(std_devs * sigma * sqrt(T)).
+    std::string exercise_method = "brennan-schwartz";    // Or "psor".
+    double psor_omega = 1.2;
+    double psor_tolerance = 1e-9;
+    std::size_t psor_max_iterations = 500;
+    std::size_t batch_size = 64;
+};
+
+
+struct PdeCurve {
+    /*
+    Solution for one contract at the evaluation time.
+
+    Attributes
+    ----------
+    spot: vector
+        The grid nodes, increasing.
+    price, delta, gamma: vector
+        The option price and its first and second spot derivatives at each node.
+
+    converged: bool
+        False if projected SOR reached psor_max_iterations at any time step.
+
+    price_at(), delta_at() and gamma_at() interpolate between nodes; the grid runs
+    from the lower barrier (or zero) to the upper barrier (or
+    strike * exp(std_devs * sigma * sqrt(T))).
+    */
+    std::vector<double> spot;
+    std::vector<double> price;
+    std::vector<double> delta;
+    std::vector<double> gamma;
+    bool converged = true;
+
+    double price_at(double s) const { return interpolate(price, s); }
+    double delta_at(double s) const { return interpolate(delta, s); }
+    double gamma_at(double s) const { return interpolate(gamma, s); }
+
+private:
+    double interpolate(const std::vector<double>& values, double s) const {
+        // Quadratic through the three nodes nearest s.
+        if (s < spot.front() || s > spot.back()) throw std::invalid_argument("Spot outside the PDE grid");
+
+        std::size_t i = std::upper_bound(spot.begin(), spot.end(), s) - spot.begin();
+        i = std::min(std::max<std::size_t>(i, 1), spot.size() - 2);
+
+        double x0 = spot[i - 1], x1 = spot[i], x2 = spot[i + 1];
+        return values[i - 1] * (s - x1) * (s - x2) / ((x0 - x1) * (x0 - x2))
+            + values[i] * (s - x0) * (s - x2) / ((x1 - x0) * (x1 - x2))
+            + values[i + 1] * (s - x0) * (s - x1) / ((x2 - x0) * (x2 - x1));
+    }
+};
+
+
+namespace pde_detail {
+
+inline std::vector<double> spot_grid(const PdeContract& c, const PdeSettings& settings) {
+    double sigma = c.vol / 100;
+    double tau = c.expiry - c.time;
+
+    double lower = c.lower_barrier > 0 ? c.lower_barrier : 0;
+    double upper = c.upper_barrier > 0 ? c.upper_barrier : c.strike * std::exp(settings.std_devs * sigma * std::sqrt(tau));
+    if (upper <= lower) throw std::invalid_argument("Upper barrier must be above lower barrier");
+
+    double alpha = settings.concentration * c.strike;
+    double c1 = std::asinh((lower - c.strike) / alpha);
+    double c2 = std::asinh((upper - c.strike) / alpha);
+
+    std::size_t n = settings.space_steps;
+    std::vector<double> s(n + 1);
+
+    // Put the strike exactly on node k, mapping each side of it separately, so the
+    // payoff kink does not move relative to the nodes as the grid is refined.
+    double k = std::round(-c1 / (c2 - c1) * double(n));
+    if (c1 < 0 && c2 > 0 && k >= 1 && k <= double(n - 1)) {
+        for (std::size_t i = 0; i <= n; i++) {
+            double xi = double(i) - k;
+            s[i] = c.strike + alpha * std::sinh(xi < 0 ? -c1 * xi / k : c2 * xi / (double(n) - k));
+        }
+    } else {
+        for (std::size_t i = 0; i <= n; i++) {
+            double xi = double(i) / double(n);
+            s[i] = c.strike + alpha * std::sinh(c1 + (c2 - c1) * xi);
+        }
+    }
+    s[0] = lower;
+    s[n] = upper;
+    return s;
+}
+
+struct Factorization {
+    // UL factorization of (I - theta * dt * L) for every contract in the batch:
+    // inv_pivot[i] = 1 / d'_i and ratio[i] = u_i / d'_{i+1}, eliminated from the
+    // top of the grid down so the back substitution runs upwards from low spot.
+    // When some contract is exercised at high spot, also the LU factorization:
+    // lu_inv_pivot[i] = 1 / d''_i and lu_ratio[i] = l_i / d''_{i-1}, eliminated from
+    // the bottom up so the back substitution runs downwards from high spot.
+    // For projected SOR, inv_diag[i] = 1 / d_i and sor_lower[i] = l_i / d_i and
+    // sor_upper[i] = u_i / d_i, zero where they would reach the boundary nodes.
+    std::vector<double> lower, inv_pivot, ratio, upper, lu_inv_pivot, lu_ratio, inv_diag, sor_lower, sor_upper;
+};
+
+inline void sor_row(std::size_t nb, double omega, const double* __restrict lower, const double* __restrict upper,
+                    const double* __restrict rhs, const double* __restrict obstacle, const double* __restrict active,
+                    const double* __restrict below, double* __restrict v, const double* __restrict above,
+                    double* __restrict change) {
+    // One projected SOR update of grid row v for every contract. The rows below and
+    // above are disjoint from v, which the restrict qualifiers tell the compiler so
+    // it vectorizes the loop without run-time overlap checks.
+    for (std::size_t c = 0; c < nb; c++) {
+        double gauss_seidel = rhs[c] - lower[c] * below[c] - upper[c] * above[c];
+        double updated = std::max(v[c] + omega * (gauss_seidel - v[c]), obstacle[c]);
+        double step = active[c] * (updated - v[c]);
+        change[c] = std::max(change[c], std::abs(step));
+        v[c] += step;
+    }
+}
+
+class Batch {
+public:
+    Batch(const std::vector<PdeContract>& contracts, std::size_t first, std::size_t count, const PdeSettings& settings)
+        : settings(settings), nb(count), n(settings.space_steps), m(settings.space_steps - 1) {
+        if (settings.exercise_method == "psor") {
+            use_psor = true;
+        } else if (settings.exercise_method == "brennan-schwartz") {
+            use_psor = false;
+        } else {
+            throw std::invalid_argument("Invalid exercise method");
+        }
+
+        s.resize((n + 1) * nb);
+        v.resize((n + 1) * nb);
+        obstacle.resize((n + 1) * nb);
+        op_l.resize((n + 1) * nb);
+        op_d.resize((n + 1) * nb);
+        op_u.resize((n + 1) * nb);
+        rhs.resize((n + 1) * nb);
+        scratch.resize((n + 1) * nb);
+
+        dt.resize(nb);
+        r.resize(nb);
+        strike.resize(nb);
+        phi.resize(nb);
+        tau.resize(nb);
+        knock_low.resize(nb);
+        knock_high.resize(nb);
+        low.resize(nb);
+        high.resize(nb);
+        change.resize(nb);
+        active.resize(nb);
+        exercise_high.resize(nb);
+        converged.assign(nb, 1);
+
+        for (std::size_t c = 0; c < nb; c++) {
+            const PdeContract& k = contracts[first + c];
+            if (k.time >= k.expiry) throw std::invalid_argument("Evaluation time must precede expiry");
+            if (k.type != "call" && k.type != "put") throw std::invalid_argument("Invalid type");
+
+            std::vector<double> grid = spot_grid(k, settings);
+            double sigma = k.vol / 100;
+            r[c] = k.rate / 100;
+            strike[c] = k.strike;
+            phi[c] = k.type == "call" ? 1 : -1;
+            tau[c] = 0;
+            dt[c] = (k.expiry - k.time) / double(settings.time_steps);
+            knock_low[c] = k.lower_barrier > 0;
+            knock_high[c] = k.upper_barrier > 0;
+
+            // Where the payoff is positive at a knock-out barrier, the contract is
+            // exercised just inside it; a put is also exercised at low spot.
+            bool exercise_low = phi[c] < 0 || (knock_low[c] && k.strike < k.lower_barrier);
+            exercise_high[c] = knock_high[c] && phi[c] * (k.upper_barrier - k.strike) > 0;
+            if (k.american && !use_psor && exercise_low && exercise_high[c] != 0) {
+                throw std::invalid_argument("Brennan-Schwartz cannot price exercise at both ends of the grid; use psor");
+            }
+            if (!k.american) exercise_high[c] = 0;
+            any_exercise_high = any_exercise_high || exercise_high[c] != 0;
+
+            for (std::size_t i = 0; i <= n; i++) {
+                std::size_t at = i * nb + c;
+                s[at] = grid[i];
+                double payoff = std::max(phi[c] * (grid[i] - k.strike), 0.0);
+                v[at] = payoff;
+                obstacle[at] = k.american ? payoff : -std::numeric_limits<double>::infinity();
+            }
+            if (knock_low[c]) v[c] = 0;
+            if (knock_high[c]) v[n * nb + c] = 0;
+
+            for (std::size_t i = 1; i < n; i++) {
+                double hm = grid[i] - grid[i - 1];
+                double hp = grid[i + 1] - grid[i];
+                double a = 0.5 * sigma * sigma * grid[i] * grid[i];
+                double b = r[c] * grid[i];
+                std::size_t at = i * nb + c;
+
+                op_l[at] = 2 * a / (hm * (hm + hp)) - b * hp / (hm * (hm + hp));
+                op_d[at] = -2 * a / (hm * hp) + b * (hp - hm) / (hm * hp) - r[c];
+                op_u[at] = 2 * a / (hp * (hm + hp)) + b * hm / (hp * (hm + hp));
+            }
+        }
+
+        crank_nicolson = factorize(0.5, 1.0);
+        implicit_half = factorize(1.0, 0.5);
+    }
+
+    void solve() {
+        std::size_t smoothing = std::min(settings.rannacher_steps, settings.time_steps);
+
+        for (std::size_t step = 0; step < settings.time_steps; step++) {
+            if (step < smoothing) {
+                advance(1.0, 0.5, implicit_half);
+                advance(1.0, 0.5, implicit_half);
+            } else {
+                advance(0.5, 1.0, crank_nicolson);
+            }
+        }
+    }
+
+    void write(std::vector<PdeCurve>& out, std::size_t first) const {
+        for (std::size_t c = 0; c < nb; c++) {
+            PdeCurve& curve = out[first + c];
+            curve.spot.resize(n + 1);
+            curve.price.resize(n + 1);
+            curve.delta.resize(n + 1);
+            curve.gamma.resize(n + 1);
+
+            for (std::size_t i = 0; i <= n; i++) {
+                curve.spot[i] = s[i * nb + c];
+                curve.price[i] = v[i * nb + c];
+            }
+            curve.converged = converged[c];
+
+            for (std::size_t i = 1; i < n; i++) {
+                double hm = curve.spot[i] - curve.spot[i - 1];
+                double hp = curve.spot[i + 1] - curve.spot[i];
+                double vm = curve.price[i - 1], v0 = curve.price[i], vp = curve.price[i + 1];
+
+                curve.delta[i] = -hp / (hm * (hm + hp)) * vm + (hp - hm) / (hm * hp) * v0 + hm / (hp * (hm + hp)) * vp;
+                curve.gamma[i] = 2 * (vm / (hm * (hm + hp)) - v0 / (hm * hp) + vp / (hp * (hm + hp)));
+            }
+
+            // One-sided differences at the edges of the grid.
+            curve.delta[0] = (curve.price[1] - curve.price[0]) / (curve.spot[1] - curve.spot[0]);
+            curve.delta[n] = (curve.price[n] - curve.price[n - 1]) / (curve.spot[n] - curve.spot[n - 1]);
+            curve.gamma[0] = curve.gamma[1];
+            curve.gamma[n] = curve.gamma[n - 1];
+        }
+    }
+
+private:
+    const PdeSettings& settings;
+    std::size_t nb;     // Contracts in the batch.
+    std::size_t n;      // Grid intervals.
+    std::size_t m;      // Interior nodes.
+    bool use_psor;
+    bool any_exercise_high = false;
+
+    std::vector<double> s, v, obstacle, op_l, op_d, op_u, rhs, scratch;
+    std::vector<double> dt, r, strike, phi, tau, low, high, change, active, exercise_high;
+    std::vector<char> knock_low, knock_high, converged;
+    Factorization crank_nicolson, implicit_half;
+
+    Factorization factorize(double theta, double fraction) const {
+        Factorization f;
+        f.lower.assign((n + 1) * nb, 0);
+        f.inv_pivot.assign((n + 1) * nb, 0);
+        f.ratio.assign((n + 1) * nb, 0);
+        f.inv_diag.assign((n + 1) * nb, 0);
+        f.sor_lower.assign((n + 1) * nb, 0);
+        f.sor_upper.assign((n + 1) * nb, 0);
+
+        std::vector<double> pivot(nb);
+        for (std::size_t i = m; i >= 1; i--) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                double k = theta * fraction * dt[c];
+                double lower = -k * op_l[at];
+                double diag = 1 - k * op_d[at];
+                double upper = -k * op_u[at];
+
+                double ratio = i == m ? 0 : upper / pivot[c];
+                double d = i == m ? diag : diag - ratio * f.lower[(i + 1) * nb + c];
+
+                f.lower[at] = lower;
+                f.ratio[at] = ratio;
+                f.inv_pivot[at] = 1 / d;
+                f.inv_diag[at] = 1 / diag;
+                f.sor_lower[at] = i == 1 ? 0 : lower / diag;
+                f.sor_upper[at] = i == m ? 0 : upper / diag;
+                pivot[c] = d;
+            }
+        }
+        if (use_psor || !any_exercise_high) return f;
+
+        f.upper.assign((n + 1) * nb, 0);
+        f.lu_inv_pivot.assign((n + 1) * nb, 0);
+        f.lu_ratio.assign((n + 1) * nb, 0);
+        for (std::size_t i = 1; i <= m; i++) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                double k = theta * fraction * dt[c];
+                double lower = -k * op_l[at];
+                double diag = 1 - k * op_d[at];
+
+                double ratio = i == 1 ? 0 : lower / pivot[c];
+                double d = i == 1 ? diag : diag - ratio * f.upper[at - nb];
+
+                f.upper[at] = -k * op_u[at];
+                f.lu_ratio[at] = ratio;
+                f.lu_inv_pivot[at] = 1 / d;
+                pivot[c] = d;
+            }
+        }
+        return f;
+    }
+
+    void boundaries(double* low, double* high) const {
+        // Dirichlet values at the ends of the grid at the current time to expiry.
+        for (std::size_t c = 0; c < nb; c++) {
+            double df = std::exp(-r[c] * tau[c]);
+            double s_low = s[c];
+            double s_high = s[n * nb + c];
+            bool american = obstacle[c] > -std::numeric_limits<double>::infinity();
+
+            if (phi[c] > 0) {
+                low[c] = 0;
+                high[c] = s_high - strike[c] * df;
+            } else {
+                low[c] = american ? strike[c] - s_low : strike[c] * df - s_low;
+                high[c] = 0;
+            }
+            if (knock_low[c]) low[c] = 0;
+            if (knock_high[c]) high[c] = 0;
+        }
+    }
+
+    void advance(double theta, double fraction, const Factorization& f) {
+        for (std::size_t c = 0; c < nb; c++) tau[c] += fraction * dt[c];
+        boundaries(low.data(), high.data());
+
+        // Explicit half of the theta scheme plus the implicit boundary terms.
+        for (std::size_t i = 1; i <= m; i++) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                double k = (1 - theta) * fraction * dt[c];
+                rhs[at] = v[at] + k * (op_l[at] * v[at - nb] + op_d[at] * v[at] + op_u[at] * v[at + nb]);
+            }
+        }
+        for (std::size_t c = 0; c < nb; c++) {
+            double k = theta * fraction * dt[c];
+            rhs[nb + c] += k * op_l[nb + c] * low[c];
+            rhs[m * nb + c] += k * op_u[m * nb + c] * high[c];
+            v[c] = low[c];
+            v[n * nb + c] = high[c];
+        }
+
+        if (use_psor) {
+            psor(f);
+        } else {
+            brennan_schwartz(f);
+        }
+    }
+
+    void brennan_schwartz(const Factorization& f) {
+        // Eliminate from the top of the grid down...
+        for (std::size_t c = 0; c < nb; c++) scratch[m * nb + c] = rhs[m * nb + c];
+        for (std::size_t i = m - 1; i >= 1; i--) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                scratch[at] = rhs[at] - f.ratio[at] * scratch[at + nb];
+            }
+        }
+
+        // ...then substitute upwards, applying the exercise constraint as we go.
+        for (std::size_t c = 0; c < nb; c++) {
+            std::size_t at = nb + c;
+            v[at] = std::max(scratch[at] * f.inv_pivot[at], obstacle[at]);
+        }
+        for (std::size_t i = 2; i <= m; i++) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                v[at] = std::max((scratch[at] - f.lower[at] * v[at - nb]) * f.inv_pivot[at], obstacle[at]);
+            }
+        }
+        if (!any_exercise_high) return;
+
+        // Contracts exercised at high spot need the mirror image: eliminate from the
+        // bottom up, substitute downwards in place, and take that solution instead.
+        for (std::size_t c = 0; c < nb; c++) scratch[nb + c] = rhs[nb + c];
+        for (std::size_t i = 2; i <= m; i++) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                scratch[at] = rhs[at] - f.lu_ratio[at] * scratch[at - nb];
+            }
+        }
+
+        for (std::size_t c = 0; c < nb; c++) {
+            std::size_t at = m * nb + c;
+            scratch[at] = std::max(scratch[at] * f.lu_inv_pivot[at], obstacle[at]);
+        }
+        for (std::size_t i = m - 1; i >= 1; i--) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                scratch[at] = std::max((scratch[at] - f.upper[at] * scratch[at + nb]) * f.lu_inv_pivot[at], obstacle[at]);
+            }
+        }
+
+        for (std::size_t i = 1; i <= m; i++) {
+            for (std::size_t c = 0; c < nb; c++) {
+                std::size_t at = i * nb + c;
+                v[at] += exercise_high[c] * (scratch[at] - v[at]);
+            }
+        }
+    }
+
+    void psor(const Factorization& f) {
+        // Projected Gauss-Seidel with over-relaxation, swept over all contracts at
+        // once; the previous time level is the starting guess. A contract stops
+        // changing once its own largest update is below psor_tolerance. The update
+        // is masked rather than skipped so the sweep over contracts stays
+        // branch-free and vectorizes.
+        std::size_t remaining = nb;
+        std::fill(active.begin(), active.end(), 1.0);
+        for (std::size_t at = nb; at < (m + 1) * nb; at++) rhs[at] *= f.inv_diag[at];
+
+        for (std::size_t iteration = 0; iteration < settings.psor_max_iterations; iteration++) {
+            std::fill(change.begin(), change.end(), 0.0);
+            for (std::size_t i = 1; i <= m; i++) {
+                std::size_t at = i * nb;
+                sor_row(nb, settings.psor_omega, &f.sor_lower[at], &f.sor_upper[at], &rhs[at], &obstacle[at],
+                        active.data(), &v[at - nb], &v[at], &v[at + nb], change.data());
+            }
+
+            for (std::size_t c = 0; c < nb; c++) {
+                if (active[c] != 0 && change[c] < settings.psor_tolerance) {
+                    active[c] = 0;
+                    remaining--;
+                }
+            }
+            if (remaining == 0) return;
+        }
+
+        for (std::size_t c = 0; c < nb; c++) {
+            if (active[c] != 0) converged[c] = 0;
+        }
+    }
+};
+
+} // namespace pde_detail
+
+
+inline std::vector<PdeCurve> solve_black_scholes_pde(const std::vector<PdeContract>& contracts,
+                                                     const PdeSettings& settings = PdeSettings()) {
+    /*
+    Solves the Black-Scholes PDE for every contract.
+
+    Parameters
+    ----------
+    contracts: vector of PdeContract
+        The contracts to price; they are solved settings.batch_size at a time.
+    settings: PdeSettings
+        Grid size, time steps, smoothing and exercise method.
+
+    Returns
+    -------
+    vector of PdeCurve
+        Price, delta and gamma against spot at the evaluation time, one per contract.
+    */
+    if (settings.space_steps < 3) throw std::invalid_argument("Need at least three space steps");
+    if (settings.time_steps < 1) throw std::invalid_argument("Need at least one time step");
+
+    std::vector<PdeCurve> curves(contracts.size());
+    std::size_t width = std::max<std::size_t>(settings.batch_size, 1);
+
+    for (std::size_t first = 0; first < contracts.size(); first += width) {
+        std::size_t count = std::min(width, contracts.size() - first);
+        pde_detail::Batch batch(contracts, first, count, settings);
+        batch.solve();
+        batch.write(curves, first);
+    }
+
+    return curves;
+}
@@ -3,11 +3,16 @@
 #include <stdexcept>
 #include <cmath>
 #include "NormalDistribution.hpp" // Check if this contains norm.cdf and norm.pdf
+#include "Instrumentation.hpp"
 
 
 double implied_vol(double price, double spot, double strike, double expiry, double rate) {
+    BS_PROBE(ImpliedVol);
+
     rate /= 100;
     double tolerance = 0.00000001;
+    int max_iterations = 100; // Newton normally converges in a handful of steps; more means a bad quote
+    int iterations = 0;
     double theta = 1;
 
     // Check if option price is within reasonable bounds
@@ -33,19 +38,23 @@ double implied_vol(double price, double spot, double strike, double expiry, doub
             exp(-x / 2) * norm.pdf(theta * (x / sigma - sigma / 2)) * (-x / (sigma * sigma) - 0.5);
         };
 
-    double sigma_c = sqrt(2 * abs(x));
+    double sigma_c = sqrt(2 * std::abs(x));
     double b_c = F(sigma_c);
 
     if (scaled_price >= b_c) {
-        double pval = (exp(theta * x / 2) - scaled_price) * norm.cdf(-sqrt(abs(x) / 2)) / (exp(theta * x / 2) - b_c);
-        double old_sigma = -2 * norm.pdf(pval);
+        double pval = (exp(theta * x / 2) - scaled_price) * norm.cdf(-sqrt(std::abs(x) / 2)) / (exp(theta * x / 2) - b_c);
+        // Jaeckel's upper starting point, sigma_u = -2 N^-1(pval)
+        double old_sigma = -2 * NormalDistribution::standard_inv_cdf(pval);
         double new_sigma = old_sigma - (F(old_sigma) - scaled_price) / Fprime(old_sigma);
+        iterations++;
 
-        while (abs(new_sigma - old_sigma) > tolerance) {
+        while (std::abs(new_sigma - old_sigma) > tolerance and iterations < max_iterations) {
             old_sigma = new_sigma;
             new_sigma = old_sigma - (F(old_sigma) - scaled_price) / Fprime(old_sigma);
+            iterations++;
         }
 
+        BS_PROBE_IV(ImpliedVol, iterations, std::abs(new_sigma - old_sigma) <= tolerance);
         return 100 * new_sigma / sqrt(expiry);
     }
 
@@ -65,13 +74,16 @@ double implied_vol(double price, double spot, double strike, double expiry, doub
         return Fprime(sigma) / (F(sigma) - iota);
         };
 
-    double old_sigma = sqrt(2 * x * x / (abs(x) - 4 * log((scaled_price - iota) / (b_c - iota))));
+    double old_sigma = sqrt(2 * x * x / (std::abs(x) - 4 * log((scaled_price - iota) / (b_c - iota))));
     double new_sigma = old_sigma - G(old_sigma) / Gprime(old_sigma);
+    iterations++;
 
-    while (abs(new_sigma - old_sigma) > tolerance) {
+    while (std::abs(new_sigma - old_sigma) > tolerance and iterations < max_iterations) {
         old_sigma = new_sigma;
         new_sigma = old_sigma - G(old_sigma) / Gprime(old_sigma);
+        iterations++;
     }
 
+    BS_PROBE_IV(ImpliedVol, iterations, std::abs(new_sigma - old_sigma) <= tolerance);
     return 100 * new_sigma / sqrt(expiry);
 }
@@ -0,0 +1,546 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+    Optional instrumentation for the pricing hot paths.
+
+    Compile with -DBS_INSTRUMENTATION to enable it. Without that flag the BS_PROBE
+    and BS_PROBE_IV hooks expand to nothing and the pricing code is unchanged; the
+    reporting API below still compiles and simply reports zero calls.
+
+    Every thread records into its own ThreadStats block (single writer, relaxed
+    atomics), so recording never takes a lock and never shares a cache line with
+    another pricing thread. When a thread exits its counts are folded into a single
+    retired total and its block is freed; snapshot(), dump() and export_csv() merge
+    the live blocks with that total.
+
+    Latency is measured with std::chrono::steady_clock. For probes as cheap as
+    NormalDistribution::cdf and inv_cdf, which the Sobol sampler calls once per path
+    and time step, the clock dominates the cost, so define
+    BS_INSTRUMENTATION_SAMPLE_SHIFT=n to time only one call in 2^n; call counts
+    stay exact.
+*/
+
+#ifndef BS_INSTRUMENTATION_SAMPLE_SHIFT
+#define BS_INSTRUMENTATION_SAMPLE_SHIFT 0
+#endif
+
+
+namespace instrumentation {
+
+enum class Probe : int {
+    BSCall,
+    BSPut,
+    BSCall_Delta,
+    BSPut_Delta,
+    BSCall_Gamma,
+    BSPut_Gamma,
+    BSCall_Theta,
+    BSPut_Theta,
+    BSCall_Vega,
+    BSPut_Vega,
+    BSGeometricAsianCall,
+    BSGeometricAsianPut,
+    BSBarrierCall,
+    BSBarrierPut,
+    NormCdf,
+    NormPdf,
+    NormInvCdf,
+    ImpliedVol,
+    ImpliedVolPrecision,
+    Count
+};
+
+constexpr int probe_count = static_cast<int>(Probe::Count);
+
+// Implied vol solvers whose Newton iteration counts are recorded by BS_PROBE_IV:
+// implied_vol in ImpliedVol.hpp and the templates in BlackScholesPrecision.hpp.
+enum class Solver : int {
+    ImpliedVol,
+    ImpliedVolPrecision,
+    Count
+};
+
+constexpr int solver_count = static_cast<int>(Solver::Count);
+
+inline const char* probe_name(Probe probe) {
+    static const char* const names[probe_count] = {
+        "BSCall", "BSPut", "BSCall_Delta", "BSPut_Delta", "BSCall_Gamma", "BSPut_Gamma",
+        "BSCall_Theta", "BSPut_Theta", "BSCall_Vega", "BSPut_Vega",
+        "BSGeometricAsianCall", "BSGeometricAsianPut", "BSBarrierCall", "BSBarrierPut",
+        "NormalDistribution::cdf", "NormalDistribution::pdf", "NormalDistribution::inv_cdf", "implied_vol",
+        "implied_vol<P>"
+    };
+    return names[static_cast<int>(probe)];
+}
+
+inline const char* solver_name(Solver solver) {
+    static const char* const names[solver_count] = {"implied_vol", "implied_vol<P>"};
+    return names[static_cast<int>(solver)];
+}
+
+
+class LatencyHistogram {
+    /*
+    HDR-style log-linear histogram of latencies in nanoseconds.
+
+    Values below 2^sub_bucket_bits are counted exactly; above that every power of
+    two is split into 2^sub_bucket_bits linear sub-buckets, so any recorded value
+    is known to within 1 / 2^sub_bucket_bits (about 6%). Values above 2^max_exponent
+    ns (about 68 s) are clamped into the last bucket.
+    */
+public:
+    static constexpr int sub_bucket_bits = 4;
+    static constexpr int sub_buckets = 1 << sub_bucket_bits;
+    static constexpr int max_exponent = 36;
+    static constexpr int bucket_count = sub_buckets + (max_exponent - sub_bucket_bits + 1) * sub_buckets;
+
+    static int bucket_index(std::uint64_t ns) {
+        if (ns < static_cast<std::uint64_t>(sub_buckets)) return static_cast<int>(ns);
+
+        int exponent = 63 - count_leading_zeros(ns);
+        if (exponent > max_exponent) return bucket_count - 1;
+
+        int shift = exponent - sub_bucket_bits;
+        int mantissa = static_cast<int>((ns >> shift) & (sub_buckets - 1));
+        return sub_buckets + shift * sub_buckets + mantissa;
+    }
+
+    static std::uint64_t bucket_lower_bound(int index) {
+        if (index < sub_buckets) return static_cast<std::uint64_t>(index);
+
+        int shift = (index - sub_buckets) / sub_buckets;
+        int mantissa = (index - sub_buckets) % sub_buckets;
+        return static_cast<std::uint64_t>(sub_buckets + mantissa) << shift;
+    }
+
+    static std::uint64_t bucket_upper_bound(int index) {
+        if (index + 1 >= bucket_count) return bucket_lower_bound(index) * 2;
+        return bucket_lower_bound(index + 1);
+    }
+
+private:
+    static int count_leading_zeros(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+        for (std::uint64_t bit = std::uint64_t(1) << 63; bit != 0 && !(x & bit); bit >>= 1) n++;
+        return n;
+#endif
+    }
+};
+
+
+// Largest iteration count tracked individually by the implied vol histogram;
+// anything above it is counted in a single overflow bucket.
+constexpr int iv_iteration_buckets = 64;
+
+
+struct alignas(64) ThreadStats {
+    // Written only by the owning thread; read by whoever calls snapshot().
+    struct ProbeStats {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> timed_calls{0};
+        std::atomic<std::uint64_t> total_ns{0};
+        std::atomic<std::uint64_t> max_ns{0};
+        std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count> histogram{};
+    };
+
+    struct SolverStats {
+        std::atomic<std::uint64_t> solves{0};
+        std::atomic<std::uint64_t> iterations{0};
+        std::atomic<std::uint64_t> max_iterations{0};
+        std::atomic<std::uint64_t> non_converged{0};
+        std::array<std::atomic<std::uint64_t>, iv_iteration_buckets + 1> histogram{};
+    };
+
+    std::array<ProbeStats, probe_count> probes{};
+    std::array<SolverStats, solver_count> solvers{};
+};
+
+
+namespace detail {
+
+inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t amount = 1) {
+    // Single writer: a relaxed load/store pair avoids a locked read-modify-write.
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void raise_to(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+    if (value > counter.load(std::memory_order_relaxed)) counter.store(value, std::memory_order_relaxed);
+}
+
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    std::shared_ptr<ThreadStats> attach() {
+        auto stats = std::make_shared<ThreadStats>();
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(stats);
+        return stats;
+    }
+
+    void detach(const std::shared_ptr<ThreadStats>& stats) {
+        // Folds an exiting thread's counts into the retired total and drops its
+        // block, so short-lived pricing threads do not accumulate.
+        std::lock_guard<std::mutex> lock(mutex);
+        merge(retired, *stats);
+        threads.erase(std::remove(threads.begin(), threads.end(), stats), threads.end());
+    }
+
+    template <typename F>
+    void for_each(F f) {
+        // Visits the live threads and the retired total under the lock, so a thread
+        // exiting meanwhile is seen exactly once.
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& stats : threads) f(*stats);
+        f(retired);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadStats>> threads;
+    ThreadStats retired;
+
+    static void merge(ThreadStats& total, const ThreadStats& stats) {
+        // total is only written under the registry lock, so the single-writer
+        // helpers still apply.
+        for (int i = 0; i < probe_count; i++) {
+            ThreadStats::ProbeStats& t = total.probes[i];
+            const ThreadStats::ProbeStats& p = stats.probes[i];
+            bump(t.calls, p.calls.load(std::memory_order_relaxed));
+            bump(t.timed_calls, p.timed_calls.load(std::memory_order_relaxed));
+            bump(t.total_ns, p.total_ns.load(std::memory_order_relaxed));
+            raise_to(t.max_ns, p.max_ns.load(std::memory_order_relaxed));
+            for (int b = 0; b < LatencyHistogram::bucket_count; b++) {
+                bump(t.histogram[b], p.histogram[b].load(std::memory_order_relaxed));
+            }
+        }
+
+        for (int i = 0; i < solver_count; i++) {
+            ThreadStats::SolverStats& t = total.solvers[i];
+            const ThreadStats::SolverStats& v = stats.solvers[i];
+            bump(t.solves, v.solves.load(std::memory_order_relaxed));
+            bump(t.iterations, v.iterations.load(std::memory_order_relaxed));
+            raise_to(t.max_iterations, v.max_iterations.load(std::memory_order_relaxed));
+            bump(t.non_converged, v.non_converged.load(std::memory_order_relaxed));
+            for (int b = 0; b <= iv_iteration_buckets; b++) {
+                bump(t.histogram[b], v.histogram[b].load(std::memory_order_relaxed));
+            }
+        }
+    }
+};
+
+struct LocalStats {
+    // Registers the thread's block on first use and retires it when the thread exits.
+    std::shared_ptr<ThreadStats> stats = Registry::instance().attach();
+    ~LocalStats() { Registry::instance().detach(stats); }
+};
+
+inline ThreadStats& local_stats() {
+    thread_local LocalStats local;
+    return *local.stats;
+}
+
+} // namespace detail
+
+
+inline void record_latency(Probe probe, std::uint64_t ns) {
+    ThreadStats::ProbeStats& p = detail::local_stats().probes[static_cast<int>(probe)];
+    detail::bump(p.timed_calls);
+    detail::bump(p.total_ns, ns);
+    detail::raise_to(p.max_ns, ns);
+    detail::bump(p.histogram[LatencyHistogram::bucket_index(ns)]);
+}
+
+inline void record_implied_vol(Solver solver, int iterations, bool converged) {
+    /*
+    Records one implied vol solve.
+
+    Parameters
+    ----------
+    solver: Solver
+        Which implied vol function ran.
+    iterations: int
+        The number of Newton steps taken.
+    converged: bool
+        False if the solver hit its iteration cap or produced a non-finite result.
+
+    Returns
+    -------
+    None
+    */
+    ThreadStats::SolverStats& stats = detail::local_stats().solvers[static_cast<int>(solver)];
+    std::uint64_t n = iterations < 0 ? 0 : static_cast<std::uint64_t>(iterations);
+
+    detail::bump(stats.solves);
+    detail::bump(stats.iterations, n);
+    detail::raise_to(stats.max_iterations, n);
+    if (!converged) detail::bump(stats.non_converged);
+    detail::bump(stats.histogram[n < iv_iteration_buckets ? n : iv_iteration_buckets]);
+}
+
+
+class ScopedProbe {
+    /*
+    Counts one call to a probe and, for sampled calls, records its latency when the
+    scope exits. Use through the BS_PROBE macro rather than directly.
+    */
+public:
+    explicit ScopedProbe(Probe probe) : probe(probe) {
+        ThreadStats::ProbeStats& p = detail::local_stats().probes[static_cast<int>(probe)];
+        std::uint64_t n = p.calls.load(std::memory_order_relaxed);
+        p.calls.store(n + 1, std::memory_order_relaxed);
+
+        timed = (n & ((std::uint64_t(1) << BS_INSTRUMENTATION_SAMPLE_SHIFT) - 1)) == 0;
+        if (timed) start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedProbe() {
+        if (!timed) return;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        record_latency(probe, static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    ScopedProbe(const ScopedProbe&) = delete;
+    ScopedProbe& operator=(const ScopedProbe&) = delete;
+
+private:
+    Probe probe;
+    bool timed;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+struct ProbeReport {
+    std::string name;
+    std::uint64_t calls = 0;
+    std::uint64_t timed_calls = 0;
+    double mean_ns = 0;
+    double p50_ns = 0;
+    double p90_ns = 0;
+    double p99_ns = 0;
+    double p999_ns = 0;
+    std::uint64_t max_ns = 0;
+    std::array<std::uint64_t, LatencyHistogram::bucket_count> histogram{};
+};
+
+struct ImpliedVolReport {
+    std::string name;
+    std::uint64_t solves = 0;
+    std::uint64_t iterations = 0;
+    std::uint64_t max_iterations = 0;
+    std::uint64_t non_converged = 0;
+    std::array<std::uint64_t, iv_iteration_buckets + 1> iteration_histogram{};
+
+    double mean_iterations() const { return solves ? double(iterations) / double(solves) : 0.0; }
+};
+
+struct Report {
+    std::vector<ProbeReport> probes;
+    std::vector<ImpliedVolReport> implied_vol;     // One per Solver.
+};
+
+
+namespace detail {
+
+inline double percentile(const std::array<std::uint64_t, LatencyHistogram::bucket_count>& histogram,
+                         std::uint64_t total, double q) {
+    // Reports the midpoint of the bucket holding the q-th quantile, by nearest rank
+    // so that tail percentiles of small samples land in the tail buckets.
+    if (total == 0) return 0.0;
+
+    std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * double(total)));
+    if (rank < 1) rank = 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::bucket_count; i++) {
+        seen += histogram[i];
+        if (seen >= rank) {
+            return 0.5 * double(LatencyHistogram::bucket_lower_bound(i) + LatencyHistogram::bucket_upper_bound(i) - 1);
+        }
+    }
+    return double(LatencyHistogram::bucket_lower_bound(LatencyHistogram::bucket_count - 1));
+}
+
+} // namespace detail
+
+
+inline Report snapshot() {
+    /*
+    Merges the statistics of every thread that has recorded anything.
+
+    Parameters
+    ----------
+    None
+
+    Returns
+    -------
+    Report
+        One ProbeReport per probe (in Probe order) and one ImpliedVolReport per
+        Solver.
+    */
+    Report report;
+    report.probes.resize(probe_count);
+    report.implied_vol.resize(solver_count);
+    for (int i = 0; i < solver_count; i++) report.implied_vol[i].name = solver_name(static_cast<Solver>(i));
+
+    std::vector<std::uint64_t> total_ns(probe_count, 0);
+
+    detail::Registry::instance().for_each([&](const ThreadStats& stats) {
+        for (int i = 0; i < probe_count; i++) {
+            const ThreadStats::ProbeStats& p = stats.probes[i];
+            ProbeReport& r = report.probes[i];
+
+            r.calls += p.calls.load(std::memory_order_relaxed);
+            r.timed_calls += p.timed_calls.load(std::memory_order_relaxed);
+            total_ns[i] += p.total_ns.load(std::memory_order_relaxed);
+
+            std::uint64_t max_ns = p.max_ns.load(std::memory_order_relaxed);
+            if (max_ns > r.max_ns) r.max_ns = max_ns;
+
+            for (int b = 0; b < LatencyHistogram::bucket_count; b++) {
+                r.histogram[b] += p.histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+
+        for (int i = 0; i < solver_count; i++) {
+            const ThreadStats::SolverStats& v = stats.solvers[i];
+            ImpliedVolReport& iv = report.implied_vol[i];
+            iv.solves += v.solves.load(std::memory_order_relaxed);
+            iv.iterations += v.iterations.load(std::memory_order_relaxed);
+            iv.non_converged += v.non_converged.load(std::memory_order_relaxed);
+
+            std::uint64_t max_iterations = v.max_iterations.load(std::memory_order_relaxed);
+            if (max_iterations > iv.max_iterations) iv.max_iterations = max_iterations;
+
+            for (int b = 0; b <= iv_iteration_buckets; b++) {
+                iv.iteration_histogram[b] += v.histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+    });
+
+    for (int i = 0; i < probe_count; i++) {
+        ProbeReport& r = report.probes[i];
+        std::uint64_t timed = 0;
+        for (std::uint64_t count : r.histogram) timed += count;
+
+        r.name = probe_name(static_cast<Probe>(i));
+        r.mean_ns = r.timed_calls ? double(total_ns[i]) / double(r.timed_calls) : 0.0;
+        r.p50_ns = detail::percentile(r.histogram, timed, 0.50);
+        r.p90_ns = detail::percentile(r.histogram, timed, 0.90);
+        r.p99_ns = detail::percentile(r.histogram, timed, 0.99);
+        r.p999_ns = detail::percentile(r.histogram, timed, 0.999);
+    }
+
+    return report;
+}
+
+inline void reset() {
+    /*
+    Zeroes the statistics of every thread. Calls that are in flight on other
+    threads while reset() runs may be partially counted.
+    */
+    detail::Registry::instance().for_each([](ThreadStats& stats) {
+        for (ThreadStats::ProbeStats& p : stats.probes) {
+            p.calls.store(0, std::memory_order_relaxed);
+            p.timed_calls.store(0, std::memory_order_relaxed);
+            p.total_ns.store(0, std::memory_order_relaxed);
+            p.max_ns.store(0, std::memory_order_relaxed);
+            for (auto& count : p.histogram) count.store(0, std::memory_order_relaxed);
+        }
+        for (ThreadStats::SolverStats& v : stats.solvers) {
+            v.solves.store(0, std::memory_order_relaxed);
+            v.iterations.store(0, std::memory_order_relaxed);
+            v.max_iterations.store(0, std::memory_order_relaxed);
+            v.non_converged.store(0, std::memory_order_relaxed);
+            for (auto& count : v.histogram) count.store(0, std::memory_order_relaxed);
+        }
+    });
+}
+
+inline void dump(std::ostream& out) {
+    /*
+    Writes a human readable summary of every probe that has been called, followed
+    by the implied vol iteration statistics.
+    */
+    Report report = snapshot();
+
+    out << "probe                       \tcalls\tmean_ns\tp50_ns\tp90_ns\tp99_ns\tp99.9_ns\tmax_ns\n";
+    for (const ProbeReport& r : report.probes) {
+        if (r.calls == 0) continue;
+        std::string name = r.name;
+        if (name.size() < 28) name.resize(28, ' ');
+        out << name << '\t' << r.calls << '\t' << r.mean_ns << '\t' << r.p50_ns << '\t' << r.p90_ns
+            << '\t' << r.p99_ns << '\t' << r.p999_ns << '\t' << r.max_ns << '\n';
+    }
+
+    for (const ImpliedVolReport& iv : report.implied_vol) {
+        if (iv.solves == 0) continue;
+        out << iv.name << " solves=" << iv.solves
+            << " mean_iterations=" << iv.mean_iterations()
+            << " max_iterations=" << iv.max_iterations
+            << " non_converged=" << iv.non_converged << '\n';
+
+        for (int b = 0; b <= iv_iteration_buckets; b++) {
+            if (iv.iteration_histogram[b] == 0) continue;
+            out << "  iterations " << (b == iv_iteration_buckets ? ">=" : "") << b << ": " << iv.iteration_histogram[b] << '\n';
+        }
+    }
+}
+
+inline void export_csv(std::ostream& out) {
+    /*
+    Writes the raw latency histograms as CSV, one row per non-empty bucket:
+    probe,bucket_lower_ns,bucket_upper_ns,count. Implied vol iteration counts are
+    written with probe "<solver>_iterations" (implied_vol_iterations,
+    implied_vol<P>_iterations) and the iteration count as both bounds.
+    */
+    Report report = snapshot();
+
+    out << "probe,bucket_lower_ns,bucket_upper_ns,count\n";
+    for (const ProbeReport& r : report.probes) {
+        for (int b = 0; b < LatencyHistogram::bucket_count; b++) {
+            if (r.histogram[b] == 0) continue;
+            out << r.name << ',' << LatencyHistogram::bucket_lower_bound(b) << ','
+                << LatencyHistogram::bucket_upper_bound(b) << ',' << r.histogram[b] << '\n';
+        }
+    }
+
+    for (const ImpliedVolReport& iv : report.implied_vol) {
+        for (int b = 0; b <= iv_iteration_buckets; b++) {
+            if (iv.iteration_histogram[b] == 0) continue;
+            out << iv.name << "_iterations," << b << ',' << b << ',' << iv.iteration_histogram[b] << '\n';
+        }
+    }
+}
+
+} // namespace instrumentation
+
+
+#ifdef BS_INSTRUMENTATION
+#define BS_PROBE_CONCAT_(a, b) a##b
+#define BS_PROBE_CONCAT(a, b) BS_PROBE_CONCAT_(a, b)
+#define BS_PROBE(probe) ::instrumentation::ScopedProbe BS_PROBE_CONCAT(bs_probe_, __LINE__)(::instrumentation::Probe::probe)
+#define BS_PROBE_IV(solver, iterations, converged) \
+    ::instrumentation::record_implied_vol(::instrumentation::Solver::solver, (iterations), (converged))
+#else
+#define BS_PROBE(probe) ((void)0)
+#define BS_PROBE_IV(solver, iterations, converged) ((void)0)
+#endif
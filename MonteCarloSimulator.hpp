@@ -0,0 +1,503 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlackScholes.hpp"
+#include "NormalDistribution.hpp"
+#include "Sobol.hpp"
+
+/*
+    Monte Carlo path engine for Black-Scholes dynamics.
+
+    Paths are generated in blocks of mc_block_paths paths stored structure-of-arrays:
+    for each time step the engine advances the log spot of every path in the block
+    with one branch-free loop and hands the step to the payoff, which keeps only the
+    running state it needs (a running sum, an extreme, a survival probability). Full
+    paths are never stored.
+
+    Blocks are grouped into fixed-size chunks and each chunk draws its random numbers
+    from a stream seeded by (seed, chunk index), or with the Sobol sampler from the
+    points of a scrambled Sobol sequence indexed by path number. Chunks are shared
+    out between worker threads but their results are combined in chunk order, so a
+    price depends only on the seed and the path count, never on the number of
+    threads.
+
+    A payoff is any copyable class providing
+
+        void begin(const PathGrid& grid, std::size_t n);
+        void observe(std::size_t step, const double* log_prev, const double* log_spot,
+                     const double* spot, const double* uniform, std::size_t n);
+        void finish(std::size_t n, double* payoff, double* control) const;
+        double control_value(const PathGrid& grid) const;
+        bool needs_uniforms() const;
+
+    observe() is called once per time step with the block's log spots before and
+    after the step (and, if needs_uniforms(), one uniform per path for Brownian bridge
+    sampling). finish() writes the undiscounted payoff and control variate of each
+    path; control_value() is the present value of the control.
+*/
+
+
+constexpr std::size_t mc_block_paths = 64;
+constexpr std::size_t mc_chunk_blocks = 16;
+constexpr std::size_t mc_chunk_paths = mc_block_paths * mc_chunk_blocks;
+
+
+struct PathGrid {
+    // Model and discretisation shared by every path. vol and rate are percentages
+    // as elsewhere; the remaining members are derived from them.
+    double spot;
+    double time;
+    double expiry;
+    double vol;
+    double rate;
+    std::size_t steps;
+
+    double dt;
+    double sigma;
+    double drift;
+    double vol_sqrt_dt;
+    double log_spot;
+    double discount;
+
+    PathGrid(double spot, double time, double expiry, double vol, double rate, std::size_t steps)
+        : spot(spot), time(time), expiry(expiry), vol(vol), rate(rate), steps(steps) {
+        dt = (expiry - time) / steps;
+        sigma = vol / 100;
+        drift = (rate / 100 - sigma * sigma / 2) * dt;
+        vol_sqrt_dt = sigma * std::sqrt(dt);
+        log_spot = std::log(spot);
+        discount = std::exp(-rate / 100 * (expiry - time));
+    }
+};
+
+
+enum class MonteCarloSampler {
+    PseudoRandom,                    // Mersenne Twister normals.
+    Sobol                            // Scrambled Sobol points with Brownian bridge construction.
+};
+
+
+struct MonteCarloSettings {
+    std::size_t paths = 100000;
+    std::size_t steps = 1;           // Time steps per path; also the Asian fixings.
+    unsigned threads = 0;            // 0 uses std::thread::hardware_concurrency().
+    std::uint64_t seed = 5489;
+    bool control_variate = true;
+    MonteCarloSampler sampler = MonteCarloSampler::PseudoRandom;
+    // Sobol only: the paths are split as evenly as possible between this many
+    // independent scrambles and the standard error is taken from the spread of their
+    // estimates. With a single scramble std_error is the pseudo-random formula, which
+    // overstates the error.
+    std::size_t randomizations = 1;
+};
+
+
+struct MonteCarloResult {
+    double price = 0;
+    double std_error = 0;
+    std::size_t paths = 0;
+    double control_beta = 0;         // Zero when no control variate was used.
+};
+
+
+inline std::uint64_t splitmix64(std::uint64_t x) {
+    // Decorrelates the per-chunk seeds derived from (seed, chunk index).
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+
+class PseudoRandomNormals {
+    /*
+    Mersenne Twister normals for one chunk of paths.
+    */
+public:
+    PseudoRandomNormals(std::uint64_t seed, std::size_t chunk)
+        : engine(splitmix64(seed ^ splitmix64(chunk))) {}
+
+    void fill(std::size_t first_path, std::size_t n, std::size_t steps, double* z) {
+        // z[step * mc_block_paths + p] for paths first_path .. first_path + n.
+        (void)first_path;
+        for (std::size_t p = 0; p < n; p++) {
+            for (std::size_t step = 0; step < steps; step++) {
+                z[step * mc_block_paths + p] = normal(engine);
+            }
+        }
+    }
+
+private:
+    std::mt19937_64 engine;
+    std::normal_distribution<double> normal;
+};
+
+
+class SobolNormals {
+    /*
+    Normals for one chunk of paths from a shared Sobol sequence with one dimension
+    per time step: path i uses point i, mapped through the inverse normal CDF and a
+    Brownian bridge.
+    */
+public:
+    SobolNormals(const SobolSequence& sequence, const BrownianBridge& bridge)
+        : sequence(sequence), bridge(bridge), x(sequence.dimensions()), z(sequence.dimensions()),
+          increments(sequence.dimensions()) {}
+
+    void fill(std::size_t first_path, std::size_t n, std::size_t steps, double* out) {
+        // out[step * mc_block_paths + p] for paths first_path .. first_path + n.
+        sequence.point(first_path, x.data());
+
+        for (std::size_t p = 0; p < n; p++) {
+            if (p > 0) sequence.next(first_path + p - 1, x.data());
+
+            for (std::size_t d = 0; d < steps; d++) {
+                z[d] = NormalDistribution::standard_inv_cdf(SobolSequence::to_unit(x[d]));
+            }
+            bridge.transform(z.data(), increments.data());
+            for (std::size_t step = 0; step < steps; step++) out[step * mc_block_paths + p] = increments[step];
+        }
+    }
+
+private:
+    const SobolSequence& sequence;
+    const BrownianBridge& bridge;
+    std::vector<std::uint32_t> x;
+    std::vector<double> z;
+    std::vector<double> increments;
+};
+
+
+namespace mc_detail {
+
+struct Moments {
+    // Sums of the discounted payoff y and control x over one chunk.
+    std::size_t n = 0;
+    double y = 0, yy = 0, x = 0, xx = 0, xy = 0;
+
+    void add(const Moments& other) {
+        n += other.n;
+        y += other.y;
+        yy += other.yy;
+        x += other.x;
+        xx += other.xx;
+        xy += other.xy;
+    }
+};
+
+struct Workspace {
+    std::vector<double> z, u, log_prev, log_spot, spot, payoff, control;
+
+    explicit Workspace(std::size_t steps)
+        : z(steps * mc_block_paths), u(steps * mc_block_paths), log_prev(mc_block_paths),
+          log_spot(mc_block_paths), spot(mc_block_paths), payoff(mc_block_paths), control(mc_block_paths) {}
+};
+
+template <typename Normals, typename Payoff>
+Moments run_chunk(const PathGrid& grid, Payoff& payoff, Normals& normals, std::mt19937_64& uniforms,
+                  Workspace& w, std::size_t first_path, std::size_t paths) {
+    Moments m;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    bool needs_uniforms = payoff.needs_uniforms();
+
+    for (std::size_t block = 0; block < paths; block += mc_block_paths) {
+        std::size_t n = std::min(mc_block_paths, paths - block);
+
+        normals.fill(first_path + block, n, grid.steps, w.z.data());
+        if (needs_uniforms) {
+            for (std::size_t i = 0; i < grid.steps * mc_block_paths; i++) w.u[i] = 1.0 - unit(uniforms);
+        }
+
+        double* log_prev = w.log_prev.data();
+        double* log_spot = w.log_spot.data();
+        double* spot = w.spot.data();
+
+        for (std::size_t p = 0; p < n; p++) log_spot[p] = grid.log_spot;
+        payoff.begin(grid, n);
+
+        for (std::size_t step = 0; step < grid.steps; step++) {
+            const double* z = w.z.data() + step * mc_block_paths;
+            for (std::size_t p = 0; p < n; p++) {
+                log_prev[p] = log_spot[p];
+                log_spot[p] += grid.drift + grid.vol_sqrt_dt * z[p];
+                spot[p] = std::exp(log_spot[p]);
+            }
+            payoff.observe(step, log_prev, log_spot, spot, w.u.data() + step * mc_block_paths, n);
+        }
+
+        payoff.finish(n, w.payoff.data(), w.control.data());
+
+        for (std::size_t p = 0; p < n; p++) {
+            double y = grid.discount * w.payoff[p];
+            double x = grid.discount * w.control[p];
+            m.y += y;
+            m.yy += y * y;
+            m.x += x;
+            m.xx += x * x;
+            m.xy += x * y;
+        }
+        m.n += n;
+    }
+
+    return m;
+}
+
+template <typename Normals, typename Payoff, typename MakeNormals>
+std::vector<Moments> run_chunks(const PathGrid& grid, const Payoff& payoff, const MonteCarloSettings& settings,
+                                MakeNormals make_normals) {
+    std::size_t chunks = (settings.paths + mc_chunk_paths - 1) / mc_chunk_paths;
+    std::vector<Moments> results(chunks);
+    std::atomic<std::size_t> next_chunk(0);
+
+    auto worker = [&]() {
+        Payoff local = payoff;
+        Workspace w(grid.steps);
+        for (std::size_t chunk = next_chunk++; chunk < chunks; chunk = next_chunk++) {
+            std::size_t first = chunk * mc_chunk_paths;
+            std::size_t paths = std::min(mc_chunk_paths, settings.paths - first);
+            Normals normals = make_normals(chunk);
+            std::mt19937_64 uniforms(splitmix64(~settings.seed ^ splitmix64(chunk)));
+            results[chunk] = run_chunk(grid, local, normals, uniforms, w, first, paths);
+        }
+    };
+
+    unsigned threads = settings.threads ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+
+    return results;
+}
+
+inline MonteCarloResult combine(const std::vector<Moments>& chunks, double control_value, bool control_variate) {
+    // Reduction in chunk order keeps the result independent of the thread count.
+    Moments m;
+    for (const Moments& chunk : chunks) m.add(chunk);
+
+    double n = double(m.n);
+    double mean_y = m.y / n;
+    double mean_x = m.x / n;
+    double var_y = (m.yy - n * mean_y * mean_y) / (n - 1);
+    double var_x = (m.xx - n * mean_x * mean_x) / (n - 1);
+    double cov = (m.xy - n * mean_x * mean_y) / (n - 1);
+
+    MonteCarloResult result;
+    result.paths = m.n;
+
+    if (!control_variate || var_x <= 0) {
+        result.price = mean_y;
+        result.std_error = std::sqrt(std::max(var_y, 0.0) / n);
+        return result;
+    }
+
+    double beta = cov / var_x;
+    result.control_beta = beta;
+    result.price = mean_y - beta * (mean_x - control_value);
+    result.std_error = std::sqrt(std::max(var_y - beta * cov, 0.0) / n);
+    return result;
+}
+
+template <typename Payoff>
+MonteCarloResult sobol_price(const PathGrid& grid, const Payoff& payoff, const MonteCarloSettings& settings,
+                             double control_value) {
+    std::size_t replications = std::max<std::size_t>(settings.randomizations, 1);
+    std::size_t paths = settings.paths / replications;
+    std::size_t extra = settings.paths % replications;   // One more path for each of the first replications.
+
+    if (paths < 2) throw std::invalid_argument("Need at least two paths per randomization");
+    if (paths + (extra ? 1 : 0) > (std::size_t(1) << SobolSequence::bits)) throw std::invalid_argument("Too many paths for a 32-bit Sobol sequence");
+
+    BrownianBridge bridge(grid.steps);
+    std::vector<MonteCarloResult> estimates;
+
+    for (std::size_t r = 0; r < replications; r++) {
+        MonteCarloSettings rep = settings;
+        rep.paths = paths + (r < extra ? 1 : 0);
+        rep.seed = replications == 1 ? settings.seed : splitmix64(settings.seed + r);
+
+        SobolSequence sequence(grid.steps, true, rep.seed);
+        auto chunks = run_chunks<SobolNormals>(grid, payoff, rep,
+            [&](std::size_t) { return SobolNormals(sequence, bridge); });
+        estimates.push_back(combine(chunks, control_value, settings.control_variate));
+    }
+
+    if (replications == 1) return estimates[0];
+
+    MonteCarloResult result;
+    double sum = 0, sum_sq = 0;
+    for (const MonteCarloResult& e : estimates) {
+        sum += e.price;
+        sum_sq += e.price * e.price;
+        result.control_beta += e.control_beta / replications;
+        result.paths += e.paths;
+    }
+
+    double k = double(replications);
+    result.price = sum / k;
+    result.std_error = std::sqrt(std::max(sum_sq - k * result.price * result.price, 0.0) / (k - 1) / k);
+    return result;
+}
+
+} // namespace mc_detail
+
+
+template <typename Payoff>
+MonteCarloResult monte_carlo_price(double spot, double time, double expiry, double vol, double rate,
+                                   const Payoff& payoff, const MonteCarloSettings& settings = MonteCarloSettings()) {
+    /*
+    Prices a payoff by simulating geometric Brownian motion paths.
+
+    Parameters
+    ----------
+    spot: float
+        The spot price of the underlying.
+    time: float
+        The time at which the price is evaluated.
+    expiry: float
+        The expiration date of the option.
+    vol: float
+        The volatility of the underlying (as a percentage).
+    rate: float
+        The risk free interest rate (as a percentage).
+    payoff: Payoff
+        The payoff to price, e.g. one of the classes in ExoticOptions.hpp.
+    settings: MonteCarloSettings
+        Path count, time steps, threads, seed and control variate switch.
+
+    Returns
+    -------
+    MonteCarloResult
+        The discounted price and its standard error.
+    */
+    if (time >= expiry) throw std::invalid_argument("Evaluation time must precede expiry");
+    if (settings.paths < 2) throw std::invalid_argument("Need at least two paths");
+    if (settings.steps < 1) throw std::invalid_argument("Need at least one time step");
+
+    PathGrid grid(spot, time, expiry, vol, rate, settings.steps);
+    double control_value = payoff.control_value(grid);
+
+    if (settings.sampler == MonteCarloSampler::Sobol) {
+        return mc_detail::sobol_price(grid, payoff, settings, control_value);
+    }
+
+    auto chunks = mc_detail::run_chunks<PseudoRandomNormals>(grid, payoff, settings,
+        [&](std::size_t chunk) { return PseudoRandomNormals(settings.seed, chunk); });
+
+    return mc_detail::combine(chunks, control_value, settings.control_variate);
+}
+
+
+class EuropeanPayoff {
+    /*
+    Vanilla European payoff, with the terminal spot (present value: spot) as control.
+    */
+public:
+    EuropeanPayoff(double strike, std::string type = "call") : strike(strike), phi(type == "call" ? 1.0 : -1.0) {
+        if (type != "call" && type != "put") throw std::invalid_argument("Invalid type");
+    }
+
+    void begin(const PathGrid&, std::size_t) {}
+
+    void observe(std::size_t, const double*, const double*, const double* spot, const double*, std::size_t n) {
+        for (std::size_t p = 0; p < n; p++) terminal[p] = spot[p];
+    }
+
+    void finish(std::size_t n, double* payoff, double* control) const {
+        for (std::size_t p = 0; p < n; p++) {
+            payoff[p] = std::max(phi * (terminal[p] - strike), 0.0);
+            control[p] = terminal[p];
+        }
+    }
+
+    double control_value(const PathGrid& grid) const { return grid.spot; }
+
+    bool needs_uniforms() const { return false; }
+
+private:
+    double strike;
+    double phi;
+    double terminal[mc_block_paths];
+};
+
+
+class MonteCarloSimulator {
+    /*
+    Class for Monte Carlo pricing of vanilla European options.
+
+    Attributes
+    ----------
+    num_simulations: int
+        The number of paths to simulate.
+    spot_price: float
+        The spot price of the underlying.
+    strike_price: float
+        The strike price of the option.
+    risk_free_rate: float
+        The risk free interest rate (as a percentage).
+    volatility: float
+        The volatility of the underlying (as a percentage).
+    maturity: float
+        The time to expiry, in years.
+    type: string
+        Either "call" or "put" indicating the option type.
+    */
+private:
+    std::size_t num_simulations;
+    double spot_price;
+    double strike_price;
+    double risk_free_rate;
+    double volatility;
+    double maturity;
+    std::string type;
+    MonteCarloResult last;
+public:
+    MonteCarloSimulator(std::size_t num_simulations, double spot_price, double strike_price, double risk_free_rate,
+                        double volatility, double maturity, std::string type = "call")
+        : num_simulations(num_simulations), spot_price(spot_price), strike_price(strike_price),
+          risk_free_rate(risk_free_rate), volatility(volatility), maturity(maturity), type(type) {
+        if (type != "call" && type != "put") throw std::invalid_argument("Invalid type");
+    }
+
+    double simulate(std::uint64_t seed = 5489) {
+        /*
+        Returns the simulated option price.
+
+        Parameters
+        ----------
+        seed: int
+            The random seed; the same seed always gives the same price.
+
+        Returns
+        -------
+        float
+            The Monte Carlo option price.
+        */
+        MonteCarloSettings settings;
+        settings.paths = num_simulations;
+        settings.seed = seed;
+
+        last = monte_carlo_price(spot_price, 0, maturity, volatility, risk_free_rate,
+                                 EuropeanPayoff(strike_price, type), settings);
+        return last.price;
+    }
+
+    double std_error() {
+        /*
+        Returns the standard error of the last simulated price.
+        */
+        return last.std_error;
+    }
+};
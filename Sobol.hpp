@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SobolTable.hpp"
+
+/*
+    Sobol low-discrepancy sequence and Brownian bridge path construction for
+    quasi-Monte Carlo pricing.
+
+    SobolSequence produces 32-bit points in Gray code order. Any point can be computed
+    directly from its index, so a chunk of paths starting at an arbitrary index gives
+    the same numbers whichever thread generates it. Optional scrambling applies a
+    random linear matrix scramble and a digital shift (Matousek 1998) to every
+    dimension; the scrambled sequence keeps its low-discrepancy structure but
+    independent scrambles give independent unbiased estimates, from which a
+    standard error can be computed.
+
+    BrownianBridge turns one Sobol point into the normal increments of a path,
+    spending the first (best distributed) dimensions on the terminal value and the
+    coarse shape of the path.
+*/
+
+
+class SobolDirectionNumbers {
+    /*
+    Primitive polynomials and initial direction integers, one entry per dimension
+    after the first.
+    */
+public:
+    struct Polynomial {
+        unsigned degree;
+        unsigned coefficients;       // Interior coefficients a, as in Joe and Kuo.
+        std::vector<unsigned> m;     // Initial odd direction integers m_1 .. m_degree.
+    };
+
+    static SobolDirectionNumbers builtin() {
+        /*
+        Returns the built-in table covering 1024 dimensions.
+        */
+        SobolDirectionNumbers numbers;
+        for (int row = 0; row < sobol_builtin_dimensions - 1; row++) {
+            const unsigned short* entry = sobol_builtin_table[row];
+            Polynomial poly;
+            poly.degree = entry[1];
+            poly.coefficients = entry[2];
+            poly.m.assign(entry + 3, entry + 3 + entry[1]);
+            numbers.polynomials.push_back(poly);
+        }
+        return numbers;
+    }
+
+    static SobolDirectionNumbers from_joe_kuo(std::istream& in) {
+        /*
+        Reads a direction number file in the format published by Joe and Kuo (e.g.
+        new-joe-kuo-6.21201): a header line followed by "d s a m_1 ... m_s" rows.
+
+        Parameters
+        ----------
+        in: istream
+            The file contents.
+
+        Returns
+        -------
+        SobolDirectionNumbers
+            One polynomial per row, in file order.
+        */
+        SobolDirectionNumbers numbers;
+        std::string line;
+        std::getline(in, line);
+
+        while (std::getline(in, line)) {
+            std::istringstream row(line);
+            unsigned d;
+            Polynomial poly;
+            if (!(row >> d >> poly.degree >> poly.coefficients)) continue;
+
+            poly.m.resize(poly.degree);
+            for (unsigned& m : poly.m) {
+                if (!(row >> m)) throw std::invalid_argument("Truncated Sobol direction number row");
+            }
+            numbers.polynomials.push_back(poly);
+        }
+        return numbers;
+    }
+
+    std::size_t max_dimensions() const { return polynomials.size() + 1; }
+
+    std::vector<Polynomial> polynomials;
+};
+
+
+class SobolSequence {
+    /*
+    Sobol sequence in Gray code order with optional scrambling.
+
+    Attributes
+    ----------
+    dimensions: int
+        The number of coordinates per point.
+    scramble: bool
+        Whether to apply a random linear matrix scramble and digital shift.
+    seed: int
+        The seed for the scramble; each seed gives an independent randomization.
+    */
+public:
+    static constexpr int bits = 32;
+
+    SobolSequence(std::size_t dimensions, bool scramble = true, std::uint64_t seed = 0,
+                  const SobolDirectionNumbers& numbers = SobolDirectionNumbers::builtin())
+        : dims(dimensions), directions(dimensions * bits), shift(dimensions, 0) {
+        if (dimensions == 0) throw std::invalid_argument("Need at least one dimension");
+        if (dimensions > numbers.max_dimensions()) throw std::invalid_argument("Not enough Sobol direction numbers");
+
+        for (std::size_t d = 0; d < dims; d++) init_directions(d, numbers);
+        if (scramble) scramble_directions(seed);
+    }
+
+    std::size_t dimensions() const { return dims; }
+
+    void point(std::uint64_t index, std::uint32_t* out) const {
+        /*
+        Writes the point with the given index (Gray code order) to out[0 .. dims).
+        */
+        std::uint64_t gray = index ^ (index >> 1);
+        for (std::size_t d = 0; d < dims; d++) out[d] = shift[d];
+
+        for (int k = 0; gray != 0 && k < bits; k++, gray >>= 1) {
+            if (!(gray & 1)) continue;
+            const std::uint32_t* v = &directions[k * dims];
+            for (std::size_t d = 0; d < dims; d++) out[d] ^= v[d];
+        }
+    }
+
+    void next(std::uint64_t index, std::uint32_t* x) const {
+        /*
+        Advances x from point index to point index + 1 with a single XOR per dimension.
+        */
+        int k = 0;
+        for (std::uint64_t i = index + 1; !(i & 1); i >>= 1) k++;
+
+        const std::uint32_t* v = &directions[k * dims];
+        for (std::size_t d = 0; d < dims; d++) x[d] ^= v[d];
+    }
+
+    static double to_unit(std::uint32_t x) {
+        // Centre of the 2^-32 cell, so the result is never exactly 0 or 1.
+        return (double(x) + 0.5) * (1.0 / 4294967296.0);
+    }
+
+private:
+    std::size_t dims;
+    std::vector<std::uint32_t> directions;   // directions[k * dims + d], bit k of dimension d.
+    std::vector<std::uint32_t> shift;
+
+    void init_directions(std::size_t d, const SobolDirectionNumbers& numbers) {
+        if (d == 0) {
+            for (int k = 0; k < bits; k++) directions[k * dims] = std::uint32_t(1) << (bits - 1 - k);
+            return;
+        }
+
+        const SobolDirectionNumbers::Polynomial& poly = numbers.polynomials[d - 1];
+        unsigned s = poly.degree;
+        std::vector<std::uint32_t> v(bits);
+
+        for (unsigned k = 0; k < s && k < unsigned(bits); k++) v[k] = std::uint32_t(poly.m[k]) << (bits - 1 - k);
+
+        for (unsigned k = s; k < unsigned(bits); k++) {
+            v[k] = v[k - s] ^ (v[k - s] >> s);
+            for (unsigned j = 1; j < s; j++) {
+                if ((poly.coefficients >> (s - 1 - j)) & 1) v[k] ^= v[k - j];
+            }
+        }
+
+        for (int k = 0; k < bits; k++) directions[k * dims + d] = v[k];
+    }
+
+    void scramble_directions(std::uint64_t seed) {
+        // Linear matrix scramble: multiply every direction number by a random lower
+        // triangular binary matrix with unit diagonal, then pick a random shift.
+        std::mt19937_64 engine(seed);
+
+        for (std::size_t d = 0; d < dims; d++) {
+            std::uint32_t rows[bits];
+            for (int i = 0; i < bits; i++) {
+                // Row i (from the most significant digit) has a 1 on the diagonal and
+                // random bits to its left.
+                std::uint32_t diagonal = std::uint32_t(1) << (bits - 1 - i);
+                std::uint32_t lower = i == 0 ? 0 : static_cast<std::uint32_t>(engine()) & ~(diagonal | (diagonal - 1));
+                rows[i] = diagonal | lower;
+            }
+
+            for (int k = 0; k < bits; k++) {
+                std::uint32_t v = directions[k * dims + d];
+                std::uint32_t scrambled = 0;
+                for (int i = 0; i < bits; i++) {
+                    if (parity(rows[i] & v)) scrambled |= std::uint32_t(1) << (bits - 1 - i);
+                }
+                directions[k * dims + d] = scrambled;
+            }
+
+            shift[d] = static_cast<std::uint32_t>(engine());
+        }
+    }
+
+    static bool parity(std::uint32_t x) {
+        x ^= x >> 16;
+        x ^= x >> 8;
+        x ^= x >> 4;
+        x ^= x >> 2;
+        x ^= x >> 1;
+        return x & 1;
+    }
+};
+
+
+class BrownianBridge {
+    /*
+    Brownian bridge construction on equally spaced time steps.
+
+    transform() takes independent standard normals in order of importance (z[0]
+    fixes the terminal value, z[1] the midpoint, and so on) and returns the path's
+    increments scaled to unit variance per step, ready to be multiplied by
+    vol * sqrt(dt) like ordinary pseudo-random normals.
+    */
+public:
+    explicit BrownianBridge(std::size_t steps)
+        : size(steps), bridge(steps), left(steps), right(steps), left_weight(steps), right_weight(steps), stddev(steps) {
+        if (steps == 0) throw std::invalid_argument("Need at least one time step");
+
+        // Times are 1 .. steps in units of dt.
+        std::vector<bool> filled(steps, false);
+        filled[steps - 1] = true;
+        bridge[0] = steps - 1;
+        stddev[0] = std::sqrt(double(steps));
+
+        std::size_t j = 0;
+        for (std::size_t i = 1; i < steps; i++) {
+            while (filled[j]) j++;
+            std::size_t k = j;
+            while (!filled[k]) k++;
+
+            // Points j .. k-1 are unknown; k is known, as is j - 1 (or time zero).
+            std::size_t l = j + ((k - 1 - j) >> 1);
+            filled[l] = true;
+            bridge[i] = l;
+            left[i] = j;
+            right[i] = k;
+
+            double t_left = double(j);
+            double t_mid = double(l + 1);
+            double t_right = double(k + 1);
+            left_weight[i] = (t_right - t_mid) / (t_right - t_left);
+            right_weight[i] = (t_mid - t_left) / (t_right - t_left);
+            stddev[i] = std::sqrt((t_mid - t_left) * (t_right - t_mid) / (t_right - t_left));
+
+            j = k + 1;
+            if (j >= steps) j = 0;
+        }
+    }
+
+    std::size_t steps() const { return size; }
+
+    void transform(const double* z, double* increments) const {
+        // Builds the Brownian path in increments[] and differences it in place.
+        double* w = increments;
+        w[size - 1] = stddev[0] * z[0];
+
+        for (std::size_t i = 1; i < size; i++) {
+            std::size_t j = left[i];
+            double left_value = j == 0 ? 0.0 : w[j - 1];
+            w[bridge[i]] = left_weight[i] * left_value + right_weight[i] * w[right[i]] + stddev[i] * z[i];
+        }
+
+        for (std::size_t i = size - 1; i > 0; i--) w[i] -= w[i - 1];
+    }
+
+private:
+    std::size_t size;
+    std::vector<std::size_t> bridge, left, right;
+    std::vector<double> left_weight, right_weight, stddev;
+};
+
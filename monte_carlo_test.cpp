@@ -0,0 +1,191 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BlackScholes.hpp"
+#include "ExoticOptions.hpp"
+#include "MonteCarloSimulator.hpp"
+#include "Sobol.hpp"
+
+/*
+    Checks for the Monte Carlo engine and the exotic payoffs.
+
+    Geometric Asian calls and puts and all eight continuously monitored barrier
+    options (single time step, Brownian bridge correction), with the strike on
+    either side of the barrier, must lie within four standard errors of their
+    closed forms in BlackScholes.hpp. Results must be bit-identical whatever the
+    number of threads.
+
+    The Sobol sequence must give the same points from next() as from point() and
+    put exactly one of its first 2^k points in each interval of width 2^-k in every
+    built-in dimension, scrambled or not. The Brownian bridge must produce
+    independent unit variance increments. For a 12-fixing arithmetic Asian,
+    scrambled Sobol paths must cut the standard error by more than 20x without the
+    control variate and 3x with it. Exits non-zero on failure:
+
+        g++ -std=c++17 -O2 -pthread monte_carlo_test.cpp -o monte_carlo_test
+        ./monte_carlo_test
+*/
+
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << what << std::endl;
+    if (!ok) failures++;
+}
+
+const double spot = 100, strike = 100, expiry = 1, vol = 20, rate = 5;
+
+template <typename Payoff>
+void check_price(const std::string& name, const Payoff& payoff, double exact, const MonteCarloSettings& settings) {
+    MonteCarloResult result = monte_carlo_price(spot, 0, expiry, vol, rate, payoff, settings);
+    // A payoff that is identically zero has no standard error.
+    double z = result.std_error > 0 ? (result.price - exact) / result.std_error : (result.price - exact) / 1e-12;
+    check(std::abs(z) < 4, name + " " + std::to_string(result.price) + " vs " + std::to_string(exact) +
+          " (" + std::to_string(z) + " standard errors)");
+}
+
+template <typename Payoff>
+void check_threads(const std::string& name, const Payoff& payoff, MonteCarloSettings settings) {
+    settings.threads = 1;
+    MonteCarloResult one = monte_carlo_price(spot, 0, expiry, vol, rate, payoff, settings);
+    settings.threads = 7;
+    MonteCarloResult many = monte_carlo_price(spot, 0, expiry, vol, rate, payoff, settings);
+    check(one.price == many.price && one.std_error == many.std_error && one.paths == many.paths,
+          name + " identical with 1 and 7 threads");
+}
+
+void check_sobol_points(bool scramble) {
+    const std::string name = scramble ? "scrambled sobol" : "sobol";
+    const std::size_t dims = SobolDirectionNumbers::builtin().max_dimensions();
+    const int k = 10;
+    const std::uint64_t count = std::uint64_t(1) << k;
+
+    SobolSequence sequence(dims, scramble, 42);
+    std::vector<std::uint32_t> stepped(dims), direct(dims);
+    std::vector<std::vector<int>> cells(dims, std::vector<int>(count, 0));
+
+    bool same = true;
+    for (std::uint64_t i = 0; i < count; i++) {
+        if (i == 0) sequence.point(0, stepped.data());
+        else sequence.next(i - 1, stepped.data());
+
+        sequence.point(i, direct.data());
+        same = same && stepped == direct;
+        for (std::size_t d = 0; d < dims; d++) cells[d][stepped[d] >> (SobolSequence::bits - k)]++;
+    }
+    check(same, name + " next() matches point() for the first " + std::to_string(count) + " points");
+
+    std::size_t stratified = 0;
+    for (std::size_t d = 0; d < dims; d++) {
+        bool one_each = true;
+        for (int n : cells[d]) one_each = one_each && n == 1;
+        if (one_each) stratified++;
+    }
+    check(stratified == dims, name + " one point per cell in " + std::to_string(stratified) + " of " +
+          std::to_string(dims) + " dimensions");
+}
+
+void check_brownian_bridge(std::size_t steps) {
+    // The bridge is linear, so feeding it unit vectors gives the matrix M with
+    // increments = M z; independent unit variance increments need M M' = I.
+    BrownianBridge bridge(steps);
+    std::vector<std::vector<double>> columns(steps, std::vector<double>(steps));
+    std::vector<double> z(steps);
+
+    for (std::size_t j = 0; j < steps; j++) {
+        std::fill(z.begin(), z.end(), 0.0);
+        z[j] = 1;
+        bridge.transform(z.data(), columns[j].data());
+    }
+
+    double worst = 0;
+    for (std::size_t a = 0; a < steps; a++) {
+        for (std::size_t b = 0; b < steps; b++) {
+            double covariance = 0;
+            for (std::size_t j = 0; j < steps; j++) covariance += columns[j][a] * columns[j][b];
+            worst = std::max(worst, std::abs(covariance - (a == b ? 1 : 0)));
+        }
+    }
+    check(worst < 1e-12, "brownian bridge covariance with " + std::to_string(steps) + " steps, error " + std::to_string(worst));
+}
+
+} // namespace
+
+
+int main() {
+    MonteCarloSettings settings;
+    settings.paths = 200000;
+
+    settings.steps = 12;
+    check_price("geometric asian call", GeometricAsianPayoff(strike, "call"),
+                BSGeometricAsianCall(spot, 0, strike, expiry, vol, rate, 12), settings);
+    check_price("geometric asian put", GeometricAsianPayoff(strike, "put"),
+                BSGeometricAsianPut(spot, 0, strike, expiry, vol, rate, 12), settings);
+
+    // Every barrier type with the strike on each side of the barrier, which covers
+    // all sixteen branches of the Reiner-Rubinstein formulas.
+    settings.steps = 1;
+    for (std::string type : {"call", "put"}) {
+        for (std::string barrier_type : {"down-and-out", "down-and-in", "up-and-out", "up-and-in"}) {
+            bool up = barrier_type.compare(0, 2, "up") == 0;
+            double barrier = up ? 120 : 90;
+            for (double k : {strike, up ? 125.0 : 85.0}) {
+                double exact = type == "call"
+                    ? BSBarrierCall(spot, 0, k, expiry, vol, rate, barrier, barrier_type)
+                    : BSBarrierPut(spot, 0, k, expiry, vol, rate, barrier, barrier_type);
+                check_price(barrier_type + " " + type + " strike " + std::to_string(int(k)),
+                            BarrierPayoff(k, type, barrier, barrier_type), exact, settings);
+            }
+        }
+    }
+
+    // Uneven chunking: the path count is not a multiple of the chunk size.
+    settings.paths = 100003;
+    settings.steps = 12;
+    check_threads("arithmetic asian", ArithmeticAsianPayoff(strike, "call"), settings);
+    check_threads("discrete barrier", BarrierPayoff(strike, "put", 90, "down-and-out", false), settings);
+
+    check_sobol_points(false);
+    check_sobol_points(true);
+    for (std::size_t steps : {1, 2, 3, 7, 12, 64, 100}) check_brownian_bridge(steps);
+
+    MonteCarloSettings sobol;
+    sobol.paths = 65536;
+    sobol.steps = 12;
+    sobol.sampler = MonteCarloSampler::Sobol;
+    sobol.randomizations = 16;
+
+    check_price("sobol geometric asian call", GeometricAsianPayoff(strike, "call"),
+                BSGeometricAsianCall(spot, 0, strike, expiry, vol, rate, 12), sobol);
+
+    // The standard error gain over pseudo-random paths, with and without the
+    // control variate (which removes much of what Sobol would otherwise gain).
+    for (bool control_variate : {false, true}) {
+        MonteCarloSettings quasi_settings = sobol;
+        quasi_settings.control_variate = control_variate;
+        MonteCarloSettings pseudo_settings = quasi_settings;
+        pseudo_settings.sampler = MonteCarloSampler::PseudoRandom;
+
+        MonteCarloResult quasi = monte_carlo_price(spot, 0, expiry, vol, rate, ArithmeticAsianPayoff(strike, "call"), quasi_settings);
+        MonteCarloResult random = monte_carlo_price(spot, 0, expiry, vol, rate, ArithmeticAsianPayoff(strike, "call"), pseudo_settings);
+        double gain = random.std_error / quasi.std_error;
+        check(gain > (control_variate ? 3 : 20), std::string("sobol standard error ") +
+              (control_variate ? "with" : "without") + " control variate " + std::to_string(gain) + "x smaller");
+    }
+
+    // 100003 paths over 8 randomizations leaves a remainder of 3.
+    sobol.paths = 100003;
+    sobol.randomizations = 8;
+    check_threads("sobol arithmetic asian", ArithmeticAsianPayoff(strike, "call"), sobol);
+    check(monte_carlo_price(spot, 0, expiry, vol, rate, ArithmeticAsianPayoff(strike, "call"), sobol).paths == sobol.paths,
+          "sobol prices every requested path");
+
+    std::cout << (failures ? "FAILED" : "PASSED") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BlackScholes.hpp"
+#include "FiniteDifference.hpp"
+
+/*
+    Grid convergence checks for solve_black_scholes_pde.
+
+    European calls and puts and down-and-out and up-and-out barrier calls are
+    compared against BSCall, BSPut and BSBarrierCall at spot = strike = 100. The error
+    must fall by about 4x each time the space and time steps are doubled. The
+    American put (strike 100, 1 year, 20% vol, 5% rate) must converge to 6.0902
+    with both exercise methods. For an American up-and-out call (barrier 130),
+    which is exercised just below the barrier, Brennan-Schwartz must match projected
+    SOR. Exits non-zero on failure:
+
+        g++ -std=c++17 -O2 pde_convergence_test.cpp -o pde_convergence_test
+        ./pde_convergence_test
+*/
+
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << what << std::endl;
+    if (!ok) failures++;
+}
+
+PdeContract contract(std::string type, bool american = false, double lower_barrier = 0, double upper_barrier = 0) {
+    PdeContract c;
+    c.strike = 100;
+    c.time = 0;
+    c.expiry = 1;
+    c.vol = 20;
+    c.rate = 5;
+    c.type = type;
+    c.american = american;
+    c.lower_barrier = lower_barrier;
+    c.upper_barrier = upper_barrier;
+    return c;
+}
+
+} // namespace
+
+
+int main() {
+    const double spot = 100;
+    const std::vector<std::size_t> grids = {100, 200, 400, 800};
+
+    std::vector<PdeContract> contracts = {
+        contract("call"),
+        contract("put"),
+        contract("call", false, 90, 0),
+        contract("call", false, 0, 130),
+        contract("put", true),
+    };
+    const std::vector<std::string> names = {"call", "put", "down-and-out call", "up-and-out call"};
+    const std::vector<double> exact = {
+        BSCall(spot, 0, 100, 1, 20, 5),
+        BSPut(spot, 0, 100, 1, 20, 5),
+        BSBarrierCall(spot, 0, 100, 1, 20, 5, 90, "down-and-out"),
+        BSBarrierCall(spot, 0, 100, 1, 20, 5, 130, "up-and-out"),
+    };
+
+    std::vector<std::vector<double>> errors(exact.size());
+    std::vector<double> american, american_psor;
+
+    for (std::size_t steps : grids) {
+        PdeSettings settings;
+        settings.space_steps = steps;
+        settings.time_steps = steps / 2;
+
+        std::vector<PdeCurve> curves = solve_black_scholes_pde(contracts, settings);
+        for (std::size_t i = 0; i < exact.size(); i++) errors[i].push_back(curves[i].price_at(spot) - exact[i]);
+        american.push_back(curves[4].price_at(spot));
+
+        settings.exercise_method = "psor";
+        PdeCurve psor = solve_black_scholes_pde({contracts[4]}, settings)[0];
+        check(psor.converged, "psor converged with " + std::to_string(steps) + " steps");
+        american_psor.push_back(psor.price_at(spot));
+    }
+
+    for (std::size_t i = 0; i < exact.size(); i++) {
+        for (std::size_t g = 1; g < grids.size(); g++) {
+            double ratio = errors[i][g - 1] / errors[i][g];
+            check(ratio > 3.5 && ratio < 4.6, names[i] + " error ratio " + std::to_string(ratio) +
+                  " from " + std::to_string(grids[g - 1]) + " to " + std::to_string(grids[g]) + " steps");
+        }
+    }
+
+    for (std::size_t g = 0; g < grids.size(); g++) {
+        check(std::abs(american_psor[g] - american[g]) < 1e-5,
+              "psor " + std::to_string(american_psor[g]) + " matches brennan-schwartz " + std::to_string(american[g]));
+        if (g >= 2) {
+            double previous = american[g - 1] - american[g - 2];
+            double latest = american[g] - american[g - 1];
+            check(latest > 0 && latest < previous / 2, "american put increments shrink: " + std::to_string(latest));
+        }
+    }
+    check(std::abs(american.back() - 6.0902) < 2e-4, "american put " + std::to_string(american.back()) + " near 6.0902");
+    check(std::abs(american_psor.back() - 6.0902) < 2e-4, "psor american put " + std::to_string(american_psor.back()) + " near 6.0902");
+
+    // Exercise at high spot, so Brennan-Schwartz has to eliminate the other way.
+    PdeSettings settings;
+    settings.space_steps = 400;
+    settings.time_steps = 200;
+    PdeCurve up_and_out = solve_black_scholes_pde({contract("call", true, 0, 130)}, settings)[0];
+    settings.exercise_method = "psor";
+    PdeCurve up_and_out_psor = solve_black_scholes_pde({contract("call", true, 0, 130)}, settings)[0];
+    check(up_and_out_psor.converged, "psor converged for the american up-and-out call");
+    for (double s : {100.0, 125.0}) {
+        double bs = up_and_out.price_at(s), psor = up_and_out_psor.price_at(s);
+        check(std::abs(bs - psor) < 1e-5, "american up-and-out call at " + std::to_string(int(s)) + ": brennan-schwartz " +
+              std::to_string(bs) + " matches psor " + std::to_string(psor));
+    }
+
+    std::cout << (failures ? "FAILED" : "PASSED") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "BlackScholes.hpp"
+#include "BlackScholesPrecision.hpp"
+#include "ImpliedVol.hpp"
+
+/*
+    Measures the maximum error of the float and mixed precision modes against the
+    double functions in BlackScholes.hpp and ImpliedVol.hpp, as tabulated in
+    BlackScholesPrecision.hpp.
+
+    Inputs are drawn uniformly from spot/strike 0.5-2 (spot 100), time to expiry
+    0.05-3 years, vol 5-80% and rate 0-10%. A further quarter as many samples are
+    drawn from the corner near the money with expiry below 0.1 years and vol below
+    7%. Delta and gamma errors are largest there, because the float rounding of
+    log(spot / strike) is divided by vol * sqrt(T) in d1:
+
+        g++ -std=c++17 -O2 precision_errors.cpp -o precision_errors
+        ./precision_errors [samples] [seed]
+*/
+
+
+struct Errors {
+    double call = 0;
+    double put = 0;
+    double call_delta = 0;
+    double put_delta = 0;
+    double gamma = 0;
+    double vega = 0;
+    double call_theta = 0;
+    double put_theta = 0;
+    double iv = 0;
+};
+
+struct Sample {
+    double spot, strike, expiry, vol, rate;
+};
+
+template <typename P>
+void measure(const Sample& s, Errors& e) {
+    typedef typename P::accumulate_type A;
+    const A spot = A(s.spot), strike = A(s.strike), expiry = A(s.expiry), vol = A(s.vol), rate = A(s.rate);
+
+    auto update = [](double& worst, double error) { worst = std::max(worst, error); };
+
+    update(e.call, std::abs(BSCall<P>(spot, 0, strike, expiry, vol, rate) - BSCall(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)) / s.spot);
+    update(e.put, std::abs(BSPut<P>(spot, 0, strike, expiry, vol, rate) - BSPut(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)) / s.spot);
+    update(e.call_delta, std::abs(BSCall_Delta<P>(spot, 0, strike, expiry, vol, rate) - BSCall_Delta(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)));
+    update(e.put_delta, std::abs(BSPut_Delta<P>(spot, 0, strike, expiry, vol, rate) - BSPut_Delta(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)));
+    update(e.vega, std::abs(BSCall_Vega<P>(spot, 0, strike, expiry, vol, rate) - BSCall_Vega(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)) / s.spot);
+    update(e.call_theta, std::abs(BSCall_Theta<P>(spot, 0, strike, expiry, vol, rate) - BSCall_Theta(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)) / s.spot);
+    update(e.put_theta, std::abs(BSPut_Theta<P>(spot, 0, strike, expiry, vol, rate) - BSPut_Theta(s.spot, 0, s.strike, s.expiry, s.vol, s.rate)) / s.spot);
+
+    // Gamma relative to its value, where gamma * spot > 1e-6.
+    double gamma = BSCall_Gamma(s.spot, 0, s.strike, s.expiry, s.vol, s.rate);
+    if (gamma * s.spot > 1e-6) {
+        update(e.gamma, std::abs(BSCall_Gamma<P>(spot, 0, strike, expiry, vol, rate) - gamma) / gamma);
+    }
+
+    // Implied vol against the generating vol, for call prices at least 1e-4 of spot
+    // above intrinsic value and below spot.
+    double price = BSCall(s.spot, 0, s.strike, s.expiry, s.vol, s.rate);
+    double intrinsic = s.spot - std::exp(-s.rate / 100 * s.expiry) * s.strike;
+    if (price >= std::max(intrinsic, 0.0) + 1e-4 * s.spot and price <= (1 - 1e-4) * s.spot) {
+        update(e.iv, std::abs(implied_vol<P>(A(price), spot, strike, expiry, rate) - s.vol));
+    }
+}
+
+void print(const char* name, double Errors::*field, const Errors& f, const Errors& m, const Errors& d) {
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(16) << f.*field << std::setw(16) << m.*field << std::setw(16) << d.*field << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    long samples = argc > 1 ? std::atol(argv[1]) : 20000000;
+    unsigned long seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+
+    std::mt19937_64 engine(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    Errors f, m, d;
+    for (long i = 0; i < samples + samples / 4; i++) {
+        bool corner = i >= samples;
+        Sample s;
+        s.spot = 100;
+        s.strike = s.spot / (corner ? 0.97 + 0.06 * uniform(engine) : 0.5 + 1.5 * uniform(engine));
+        s.expiry = corner ? 0.05 + 0.05 * uniform(engine) : 0.05 + 2.95 * uniform(engine);
+        s.vol = corner ? 5 + 2 * uniform(engine) : 5 + 75 * uniform(engine);
+        s.rate = 10 * uniform(engine);
+
+        measure<FloatPrecision>(s, f);
+        measure<MixedPrecision>(s, m);
+        measure<DoublePrecision>(s, d);
+    }
+
+    std::cout << std::scientific << std::setprecision(1) << samples << " + " << samples / 4 << " samples" << std::endl;
+    std::cout << std::left << std::setw(28) << "" << std::right
+              << std::setw(16) << "FloatPrecision" << std::setw(16) << "MixedPrecision" << std::setw(16) << "DoublePrecision" << std::endl;
+    print("call price / spot", &Errors::call, f, m, d);
+    print("put price / spot", &Errors::put, f, m, d);
+    print("call delta", &Errors::call_delta, f, m, d);
+    print("put delta", &Errors::put_delta, f, m, d);
+    print("gamma (relative)", &Errors::gamma, f, m, d);
+    print("vega / spot", &Errors::vega, f, m, d);
+    print("1 day call theta / spot", &Errors::call_theta, f, m, d);
+    print("1 day put theta / spot", &Errors::put_theta, f, m, d);
+    print("implied vol (vol points)", &Errors::iv, f, m, d);
+}